@@ -0,0 +1,33 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/counters.cc" "CMakeFiles/energy.dir/src/counters.cc.o" "gcc" "CMakeFiles/energy.dir/src/counters.cc.o.d"
+  "/root/repo/src/energy.cc" "CMakeFiles/energy.dir/src/energy.cc.o" "gcc" "CMakeFiles/energy.dir/src/energy.cc.o.d"
+  "/root/repo/src/estimate.cc" "CMakeFiles/energy.dir/src/estimate.cc.o" "gcc" "CMakeFiles/energy.dir/src/estimate.cc.o.d"
+  "/root/repo/src/event_loop.cc" "CMakeFiles/energy.dir/src/event_loop.cc.o" "gcc" "CMakeFiles/energy.dir/src/event_loop.cc.o.d"
+  "/root/repo/src/execute.cc" "CMakeFiles/energy.dir/src/execute.cc.o" "gcc" "CMakeFiles/energy.dir/src/execute.cc.o.d"
+  "/root/repo/src/main.cc" "CMakeFiles/energy.dir/src/main.cc.o" "gcc" "CMakeFiles/energy.dir/src/main.cc.o.d"
+  "/root/repo/src/measure.cc" "CMakeFiles/energy.dir/src/measure.cc.o" "gcc" "CMakeFiles/energy.dir/src/measure.cc.o.d"
+  "/root/repo/src/normal_process.cc" "CMakeFiles/energy.dir/src/normal_process.cc.o" "gcc" "CMakeFiles/energy.dir/src/normal_process.cc.o.d"
+  "/root/repo/src/procfs.cc" "CMakeFiles/energy.dir/src/procfs.cc.o" "gcc" "CMakeFiles/energy.dir/src/procfs.cc.o.d"
+  "/root/repo/src/program.cc" "CMakeFiles/energy.dir/src/program.cc.o" "gcc" "CMakeFiles/energy.dir/src/program.cc.o.d"
+  "/root/repo/src/publish.cc" "CMakeFiles/energy.dir/src/publish.cc.o" "gcc" "CMakeFiles/energy.dir/src/publish.cc.o.d"
+  "/root/repo/src/sampler.cc" "CMakeFiles/energy.dir/src/sampler.cc.o" "gcc" "CMakeFiles/energy.dir/src/sampler.cc.o.d"
+  "/root/repo/src/threads.cc" "CMakeFiles/energy.dir/src/threads.cc.o" "gcc" "CMakeFiles/energy.dir/src/threads.cc.o.d"
+  "/root/repo/src/topology.cc" "CMakeFiles/energy.dir/src/topology.cc.o" "gcc" "CMakeFiles/energy.dir/src/topology.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_bench_build/CMakeFiles/eteam.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,37 @@
+file(REMOVE_RECURSE
+  "/root/repo/bin/energy"
+  "/root/repo/bin/energy.pdb"
+  "CMakeFiles/energy.dir/src/counters.cc.o"
+  "CMakeFiles/energy.dir/src/counters.cc.o.d"
+  "CMakeFiles/energy.dir/src/energy.cc.o"
+  "CMakeFiles/energy.dir/src/energy.cc.o.d"
+  "CMakeFiles/energy.dir/src/estimate.cc.o"
+  "CMakeFiles/energy.dir/src/estimate.cc.o.d"
+  "CMakeFiles/energy.dir/src/event_loop.cc.o"
+  "CMakeFiles/energy.dir/src/event_loop.cc.o.d"
+  "CMakeFiles/energy.dir/src/execute.cc.o"
+  "CMakeFiles/energy.dir/src/execute.cc.o.d"
+  "CMakeFiles/energy.dir/src/main.cc.o"
+  "CMakeFiles/energy.dir/src/main.cc.o.d"
+  "CMakeFiles/energy.dir/src/measure.cc.o"
+  "CMakeFiles/energy.dir/src/measure.cc.o.d"
+  "CMakeFiles/energy.dir/src/normal_process.cc.o"
+  "CMakeFiles/energy.dir/src/normal_process.cc.o.d"
+  "CMakeFiles/energy.dir/src/procfs.cc.o"
+  "CMakeFiles/energy.dir/src/procfs.cc.o.d"
+  "CMakeFiles/energy.dir/src/program.cc.o"
+  "CMakeFiles/energy.dir/src/program.cc.o.d"
+  "CMakeFiles/energy.dir/src/publish.cc.o"
+  "CMakeFiles/energy.dir/src/publish.cc.o.d"
+  "CMakeFiles/energy.dir/src/sampler.cc.o"
+  "CMakeFiles/energy.dir/src/sampler.cc.o.d"
+  "CMakeFiles/energy.dir/src/threads.cc.o"
+  "CMakeFiles/energy.dir/src/threads.cc.o.d"
+  "CMakeFiles/energy.dir/src/topology.cc.o"
+  "CMakeFiles/energy.dir/src/topology.cc.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/energy.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
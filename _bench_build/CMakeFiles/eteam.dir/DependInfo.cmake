@@ -0,0 +1,22 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/eteam.cc" "CMakeFiles/eteam.dir/src/eteam.cc.o" "gcc" "CMakeFiles/eteam.dir/src/eteam.cc.o.d"
+  "/root/repo/src/profile.cc" "CMakeFiles/eteam.dir/src/profile.cc.o" "gcc" "CMakeFiles/eteam.dir/src/profile.cc.o.d"
+  "/root/repo/src/shm.cc" "CMakeFiles/eteam.dir/src/shm.cc.o" "gcc" "CMakeFiles/eteam.dir/src/shm.cc.o.d"
+  "/root/repo/src/uring.cc" "CMakeFiles/eteam.dir/src/uring.cc.o" "gcc" "CMakeFiles/eteam.dir/src/uring.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,17 @@
+file(REMOVE_RECURSE
+  "/root/repo/lib/libeteam.a"
+  "/root/repo/lib/libeteam.pdb"
+  "CMakeFiles/eteam.dir/src/eteam.cc.o"
+  "CMakeFiles/eteam.dir/src/eteam.cc.o.d"
+  "CMakeFiles/eteam.dir/src/profile.cc.o"
+  "CMakeFiles/eteam.dir/src/profile.cc.o.d"
+  "CMakeFiles/eteam.dir/src/shm.cc.o"
+  "CMakeFiles/eteam.dir/src/shm.cc.o.d"
+  "CMakeFiles/eteam.dir/src/uring.cc.o"
+  "CMakeFiles/eteam.dir/src/uring.cc.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/eteam.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,29 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/counters.cc" "bench/CMakeFiles/bench_launch.dir/__/src/counters.cc.o" "gcc" "bench/CMakeFiles/bench_launch.dir/__/src/counters.cc.o.d"
+  "/root/repo/src/energy.cc" "bench/CMakeFiles/bench_launch.dir/__/src/energy.cc.o" "gcc" "bench/CMakeFiles/bench_launch.dir/__/src/energy.cc.o.d"
+  "/root/repo/src/estimate.cc" "bench/CMakeFiles/bench_launch.dir/__/src/estimate.cc.o" "gcc" "bench/CMakeFiles/bench_launch.dir/__/src/estimate.cc.o.d"
+  "/root/repo/src/execute.cc" "bench/CMakeFiles/bench_launch.dir/__/src/execute.cc.o" "gcc" "bench/CMakeFiles/bench_launch.dir/__/src/execute.cc.o.d"
+  "/root/repo/src/measure.cc" "bench/CMakeFiles/bench_launch.dir/__/src/measure.cc.o" "gcc" "bench/CMakeFiles/bench_launch.dir/__/src/measure.cc.o.d"
+  "/root/repo/src/normal_process.cc" "bench/CMakeFiles/bench_launch.dir/__/src/normal_process.cc.o" "gcc" "bench/CMakeFiles/bench_launch.dir/__/src/normal_process.cc.o.d"
+  "/root/repo/src/procfs.cc" "bench/CMakeFiles/bench_launch.dir/__/src/procfs.cc.o" "gcc" "bench/CMakeFiles/bench_launch.dir/__/src/procfs.cc.o.d"
+  "/root/repo/src/program.cc" "bench/CMakeFiles/bench_launch.dir/__/src/program.cc.o" "gcc" "bench/CMakeFiles/bench_launch.dir/__/src/program.cc.o.d"
+  "/root/repo/src/topology.cc" "bench/CMakeFiles/bench_launch.dir/__/src/topology.cc.o" "gcc" "bench/CMakeFiles/bench_launch.dir/__/src/topology.cc.o.d"
+  "/root/repo/bench/launch_bench.cc" "bench/CMakeFiles/bench_launch.dir/launch_bench.cc.o" "gcc" "bench/CMakeFiles/bench_launch.dir/launch_bench.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_bench_build/CMakeFiles/eteam.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,29 @@
+file(REMOVE_RECURSE
+  "/root/repo/bin/bench_launch"
+  "/root/repo/bin/bench_launch.pdb"
+  "CMakeFiles/bench_launch.dir/__/src/counters.cc.o"
+  "CMakeFiles/bench_launch.dir/__/src/counters.cc.o.d"
+  "CMakeFiles/bench_launch.dir/__/src/energy.cc.o"
+  "CMakeFiles/bench_launch.dir/__/src/energy.cc.o.d"
+  "CMakeFiles/bench_launch.dir/__/src/estimate.cc.o"
+  "CMakeFiles/bench_launch.dir/__/src/estimate.cc.o.d"
+  "CMakeFiles/bench_launch.dir/__/src/execute.cc.o"
+  "CMakeFiles/bench_launch.dir/__/src/execute.cc.o.d"
+  "CMakeFiles/bench_launch.dir/__/src/measure.cc.o"
+  "CMakeFiles/bench_launch.dir/__/src/measure.cc.o.d"
+  "CMakeFiles/bench_launch.dir/__/src/normal_process.cc.o"
+  "CMakeFiles/bench_launch.dir/__/src/normal_process.cc.o.d"
+  "CMakeFiles/bench_launch.dir/__/src/procfs.cc.o"
+  "CMakeFiles/bench_launch.dir/__/src/procfs.cc.o.d"
+  "CMakeFiles/bench_launch.dir/__/src/program.cc.o"
+  "CMakeFiles/bench_launch.dir/__/src/program.cc.o.d"
+  "CMakeFiles/bench_launch.dir/__/src/topology.cc.o"
+  "CMakeFiles/bench_launch.dir/__/src/topology.cc.o.d"
+  "CMakeFiles/bench_launch.dir/launch_bench.cc.o"
+  "CMakeFiles/bench_launch.dir/launch_bench.cc.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/bench_launch.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,20 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/procfs.cc" "bench/CMakeFiles/bench_procfs.dir/__/src/procfs.cc.o" "gcc" "bench/CMakeFiles/bench_procfs.dir/__/src/procfs.cc.o.d"
+  "/root/repo/bench/procfs_bench.cc" "bench/CMakeFiles/bench_procfs.dir/procfs_bench.cc.o" "gcc" "bench/CMakeFiles/bench_procfs.dir/procfs_bench.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
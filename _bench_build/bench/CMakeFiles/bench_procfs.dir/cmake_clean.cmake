@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "/root/repo/bin/bench_procfs"
+  "/root/repo/bin/bench_procfs.pdb"
+  "CMakeFiles/bench_procfs.dir/__/src/procfs.cc.o"
+  "CMakeFiles/bench_procfs.dir/__/src/procfs.cc.o.d"
+  "CMakeFiles/bench_procfs.dir/procfs_bench.cc.o"
+  "CMakeFiles/bench_procfs.dir/procfs_bench.cc.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/bench_procfs.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "/root/repo/bin/bench_restart"
+  "/root/repo/bin/bench_restart.pdb"
+  "CMakeFiles/bench_restart.dir/restart_bench.cc.o"
+  "CMakeFiles/bench_restart.dir/restart_bench.cc.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/bench_restart.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,20 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/uring.cc" "bench/CMakeFiles/bench_uring.dir/__/src/uring.cc.o" "gcc" "bench/CMakeFiles/bench_uring.dir/__/src/uring.cc.o.d"
+  "/root/repo/bench/uring_bench.cc" "bench/CMakeFiles/bench_uring.dir/uring_bench.cc.o" "gcc" "bench/CMakeFiles/bench_uring.dir/uring_bench.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "/root/repo/bin/bench_uring"
+  "/root/repo/bin/bench_uring.pdb"
+  "CMakeFiles/bench_uring.dir/__/src/uring.cc.o"
+  "CMakeFiles/bench_uring.dir/__/src/uring.cc.o.d"
+  "CMakeFiles/bench_uring.dir/uring_bench.cc.o"
+  "CMakeFiles/bench_uring.dir/uring_bench.cc.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/bench_uring.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
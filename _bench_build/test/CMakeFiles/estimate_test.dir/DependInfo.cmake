@@ -0,0 +1,21 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/energy.cc" "test/CMakeFiles/estimate_test.dir/__/src/energy.cc.o" "gcc" "test/CMakeFiles/estimate_test.dir/__/src/energy.cc.o.d"
+  "/root/repo/src/estimate.cc" "test/CMakeFiles/estimate_test.dir/__/src/estimate.cc.o" "gcc" "test/CMakeFiles/estimate_test.dir/__/src/estimate.cc.o.d"
+  "/root/repo/test/estimate_test.cc" "test/CMakeFiles/estimate_test.dir/estimate_test.cc.o" "gcc" "test/CMakeFiles/estimate_test.dir/estimate_test.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,15 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/estimate_test.dir/__/src/energy.cc.o"
+  "CMakeFiles/estimate_test.dir/__/src/energy.cc.o.d"
+  "CMakeFiles/estimate_test.dir/__/src/estimate.cc.o"
+  "CMakeFiles/estimate_test.dir/__/src/estimate.cc.o.d"
+  "CMakeFiles/estimate_test.dir/estimate_test.cc.o"
+  "CMakeFiles/estimate_test.dir/estimate_test.cc.o.d"
+  "estimate_test"
+  "estimate_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/estimate_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/pid_cache_test.dir/fake_proc.cc.o"
+  "CMakeFiles/pid_cache_test.dir/fake_proc.cc.o.d"
+  "CMakeFiles/pid_cache_test.dir/pid_cache_test.cc.o"
+  "CMakeFiles/pid_cache_test.dir/pid_cache_test.cc.o.d"
+  "pid_cache_test"
+  "pid_cache_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/pid_cache_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,26 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/counters.cc" "test/CMakeFiles/rapl_units_test.dir/__/src/counters.cc.o" "gcc" "test/CMakeFiles/rapl_units_test.dir/__/src/counters.cc.o.d"
+  "/root/repo/src/energy.cc" "test/CMakeFiles/rapl_units_test.dir/__/src/energy.cc.o" "gcc" "test/CMakeFiles/rapl_units_test.dir/__/src/energy.cc.o.d"
+  "/root/repo/src/estimate.cc" "test/CMakeFiles/rapl_units_test.dir/__/src/estimate.cc.o" "gcc" "test/CMakeFiles/rapl_units_test.dir/__/src/estimate.cc.o.d"
+  "/root/repo/src/measure.cc" "test/CMakeFiles/rapl_units_test.dir/__/src/measure.cc.o" "gcc" "test/CMakeFiles/rapl_units_test.dir/__/src/measure.cc.o.d"
+  "/root/repo/src/procfs.cc" "test/CMakeFiles/rapl_units_test.dir/__/src/procfs.cc.o" "gcc" "test/CMakeFiles/rapl_units_test.dir/__/src/procfs.cc.o.d"
+  "/root/repo/src/topology.cc" "test/CMakeFiles/rapl_units_test.dir/__/src/topology.cc.o" "gcc" "test/CMakeFiles/rapl_units_test.dir/__/src/topology.cc.o.d"
+  "/root/repo/test/rapl_units_test.cc" "test/CMakeFiles/rapl_units_test.dir/rapl_units_test.cc.o" "gcc" "test/CMakeFiles/rapl_units_test.dir/rapl_units_test.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_bench_build/CMakeFiles/eteam.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,23 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/rapl_units_test.dir/__/src/counters.cc.o"
+  "CMakeFiles/rapl_units_test.dir/__/src/counters.cc.o.d"
+  "CMakeFiles/rapl_units_test.dir/__/src/energy.cc.o"
+  "CMakeFiles/rapl_units_test.dir/__/src/energy.cc.o.d"
+  "CMakeFiles/rapl_units_test.dir/__/src/estimate.cc.o"
+  "CMakeFiles/rapl_units_test.dir/__/src/estimate.cc.o.d"
+  "CMakeFiles/rapl_units_test.dir/__/src/measure.cc.o"
+  "CMakeFiles/rapl_units_test.dir/__/src/measure.cc.o.d"
+  "CMakeFiles/rapl_units_test.dir/__/src/procfs.cc.o"
+  "CMakeFiles/rapl_units_test.dir/__/src/procfs.cc.o.d"
+  "CMakeFiles/rapl_units_test.dir/__/src/topology.cc.o"
+  "CMakeFiles/rapl_units_test.dir/__/src/topology.cc.o.d"
+  "CMakeFiles/rapl_units_test.dir/rapl_units_test.cc.o"
+  "CMakeFiles/rapl_units_test.dir/rapl_units_test.cc.o.d"
+  "rapl_units_test"
+  "rapl_units_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/rapl_units_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/shm_test.dir/shm_test.cc.o"
+  "CMakeFiles/shm_test.dir/shm_test.cc.o.d"
+  "shm_test"
+  "shm_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/shm_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/topology_test.dir/__/src/topology.cc.o"
+  "CMakeFiles/topology_test.dir/__/src/topology.cc.o.d"
+  "CMakeFiles/topology_test.dir/topology_test.cc.o"
+  "CMakeFiles/topology_test.dir/topology_test.cc.o.d"
+  "topology_test"
+  "topology_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/topology_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
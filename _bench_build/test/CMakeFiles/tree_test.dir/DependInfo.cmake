@@ -0,0 +1,21 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/test/fake_proc.cc" "test/CMakeFiles/tree_test.dir/fake_proc.cc.o" "gcc" "test/CMakeFiles/tree_test.dir/fake_proc.cc.o.d"
+  "/root/repo/test/tree_test.cc" "test/CMakeFiles/tree_test.dir/tree_test.cc.o" "gcc" "test/CMakeFiles/tree_test.dir/tree_test.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_bench_build/CMakeFiles/eteam.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,18 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/test
+# Build directory: /root/repo/_bench_build/test
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(rapl_units "/root/repo/_bench_build/test/rapl_units_test")
+set_tests_properties(rapl_units PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;25;add_test;/root/repo/test/CMakeLists.txt;0;")
+add_test(estimate "/root/repo/_bench_build/test/estimate_test")
+set_tests_properties(estimate PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;37;add_test;/root/repo/test/CMakeLists.txt;0;")
+add_test(topology "/root/repo/_bench_build/test/topology_test")
+set_tests_properties(topology PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;48;add_test;/root/repo/test/CMakeLists.txt;0;")
+add_test(pid_cache "/root/repo/_bench_build/test/pid_cache_test")
+set_tests_properties(pid_cache PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;67;add_test;/root/repo/test/CMakeLists.txt;0;")
+add_test(tree "/root/repo/_bench_build/test/tree_test")
+set_tests_properties(tree PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;67;add_test;/root/repo/test/CMakeLists.txt;0;")
+add_test(shm "/root/repo/_bench_build/test/shm_test")
+set_tests_properties(shm PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;83;add_test;/root/repo/test/CMakeLists.txt;0;")
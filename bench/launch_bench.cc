@@ -0,0 +1,135 @@
+/**
+ * Launch latency of Program::run() on a trivial program (this benchmark itself
+ * in stamp mode, which only records when it reached main()). "blocked" is how
+ * long the watcher waits inside run(), "launch" is the time until the program
+ * is running. The watcher can be made larger with BALLAST_MB of resident
+ * memory, which a fork has to copy the page tables of. With 'held', the
+ * program is held before its exec to open the hardware counters (like with
+ * --counters).
+ *
+ * Usage: bench_launch [RUNS] [BALLAST_MB] [held]
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../src/program.h"
+
+
+using Clock = std::chrono::steady_clock;
+
+static long long now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+/* Append the time at which main() was reached to the file */
+static int stamp(const char *file)
+{
+    auto start = now();
+
+    char buf[32];
+    int len = std::snprintf(buf, sizeof(buf), "%lld\n", start);
+
+    int fd = open(file, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || write(fd, buf, len) != len)
+        return 1;
+
+    close(fd);
+    return 0;
+}
+
+static void print(const char *name, std::vector<long long> v)
+{
+    std::sort(v.begin(), v.end());
+
+    auto pct = [&v](double p) {
+        return v[std::min(v.size() - 1, static_cast<size_t>(p * v.size()))] / 1000.0;
+    };
+
+    std::printf("%-8s p50 %8.1f us, p90 %8.1f us, p99 %8.1f us\n", name, pct(0.5), pct(0.9), pct(0.99));
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && std::string{argv[1]} == "--stamp")
+        return stamp(argv[2]);
+
+    int runs = argc > 1 ? std::atoi(argv[1]) : 2000;
+    size_t ballast_mb = argc > 2 ? std::atoi(argv[2]) : 0;
+    bool held = argc > 3 && std::string{argv[3]} == "held";
+
+    if (runs <= 0) {
+        std::fprintf(stderr, "Usage: %s [RUNS] [BALLAST_MB] [held]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<char> ballast(ballast_mb << 20);
+    std::memset(ballast.data(), 1, ballast.size());
+
+    char file[] = "/tmp/bench_launch.XXXXXX";
+    int fd = mkstemp(file);
+    if (fd < 0) {
+        std::perror("mkstemp");
+        return 1;
+    }
+
+    close(fd);
+
+    char self[4096];
+    auto len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    self[len > 0 ? len : 0] = '\0';
+
+    char stamp_arg[] = "--stamp";
+    char *args[] = {argv[0], self, stamp_arg, file, nullptr};
+    Program prog{4, args, 1, NONE};
+
+    if (held)
+        prog.count(false);
+
+    std::vector<long long> starts, blocked;
+
+    for (int i = 0; i < runs; ++i) {
+        auto start = now();
+        auto proc = prog.run();
+
+        blocked.push_back(now() - start);
+        starts.push_back(start);
+
+        proc->wait();
+    }
+
+    std::vector<long long> launch;
+
+    std::FILE *stamps = std::fopen(file, "r");
+    if (stamps) {
+        long long t;
+
+        while (launch.size() < starts.size() && std::fscanf(stamps, "%lld", &t) == 1)
+            launch.push_back(t - starts[launch.size()]);
+
+        std::fclose(stamps);
+    }
+
+    unlink(file);
+
+    std::printf("%d %sruns with %zu MB ballast\n", runs, held ? "held " : "", ballast_mb);
+    print("blocked", blocked);
+
+    if (launch.size() != blocked.size()) {
+        std::printf("Only %zu of the runs reached main()\n", launch.size());
+        return 1;
+    }
+
+    print("launch", launch);
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * Per-call cost of reading the CPU times of a process from '/proc/<pid>/stat',
+ * once with the iostream based code that NormalProcess::time() used before
+ * and once with the allocation-free parser in procfs.
+ *
+ * Usage: bench_procfs [CALLS]
+ **/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "../src/procfs.h"
+
+
+using Clock = std::chrono::steady_clock;
+
+static double iostream_time(pid_t pid)
+{
+    std::stringstream path;
+    path << "/proc/" << pid << "/stat";
+
+    std::ifstream stat{path.str()};
+
+    /* utime and stime are the 14th and 15th field */
+    for (int i = 1; i < 14; ++i)
+        stat.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
+
+    double utime, stime;
+    stat >> utime >> stime;
+
+    return utime / sysconf(_SC_CLK_TCK) + stime / sysconf(_SC_CLK_TCK);
+}
+
+static double procfs_time(pid_t pid)
+{
+    procfs::Stat stat;
+
+    if (!procfs::read_stat(pid, stat))
+        return 0;
+
+    return static_cast<double>(stat.utime) / procfs::clock_ticks() +
+        static_cast<double>(stat.stime) / procfs::clock_ticks();
+}
+
+template <typename F>
+static double per_call(F func, pid_t pid, int calls, double &sink)
+{
+    auto start = Clock::now();
+
+    for (int i = 0; i < calls; ++i)
+        sink += func(pid);
+
+    std::chrono::duration<double, std::micro> d = Clock::now() - start;
+    return d.count() / calls;
+}
+
+int main(int argc, char *argv[])
+{
+    int calls = (argc > 1) ? std::atoi(argv[1]) : 200000;
+    pid_t pid = getpid();
+    double sink = 0;
+
+    /* Warm up the dentry cache */
+    per_call(procfs_time, pid, 1000, sink);
+
+    std::printf("iostream: %6.2f us/call\n", per_call(iostream_time, pid, calls, sink));
+    std::printf("procfs:   %6.2f us/call\n", per_call(procfs_time, pid, calls, sink));
+
+    return sink < 0;
+}
@@ -0,0 +1,214 @@
+/**
+ * Restart latency of the process watcher with many concurrent programs. The
+ * energy tool repeats PROGRAMS trivial programs (this benchmark itself in
+ * stamp mode), each of which sleeps a random time of up to SLEEP_MS and
+ * records when it started and exited. After SECONDS the watcher is stopped
+ * with SIGINT. Only the runs that finished up to two seconds before that are
+ * counted, since the watcher may still restart programs while it stops. The
+ * restart latency is the time from the exit of a run to the start of the next
+ * run of the same program.
+ *
+ * Usage: bench_restart [ENERGY] [PROGRAMS] [SECONDS] [SLEEP_MS]
+ *
+ * ENERGY defaults to the energy binary next to this one. Every program uses
+ * a file descriptor of the watcher, so raise the limit (ulimit -n) for more
+ * than about 1000 of them.
+ **/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+using Clock = std::chrono::steady_clock;
+
+static long long now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+/* A single run: sleep, then append "<slot> <start ns> <exit ns>" to the file */
+static int stamp(const char *slot, const char *file, long sleep_ms)
+{
+    auto start = now();
+
+    if (sleep_ms > 0) {
+        unsigned seed = start ^ getpid();
+        std::this_thread::sleep_for(std::chrono::microseconds{rand_r(&seed) % (sleep_ms * 1000)});
+    }
+
+    char buf[128];
+    int len = std::snprintf(buf, sizeof(buf), "%s %lld %lld\n", slot, start, now());
+
+    int fd = open(file, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || write(fd, buf, len) != len)
+        return 1;
+
+    close(fd);
+    return 0;
+}
+
+static std::string self()
+{
+    char buf[4096];
+    auto len = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+
+    return std::string(buf, len > 0 ? len : 0);
+}
+
+/* User and system time of a process (in s) */
+static std::pair<double, double> cpu_time(pid_t pid)
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    unsigned long long utime = 0, stime = 0;
+    std::FILE *file = std::fopen(path, "r");
+
+    if (file) {
+        char buf[1024];
+        auto len = std::fread(buf, 1, sizeof(buf) - 1, file);
+        buf[len] = '\0';
+
+        const char *p = std::strrchr(buf, ')');
+        if (p)
+            std::sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime);
+
+        std::fclose(file);
+    }
+
+    double ticks = sysconf(_SC_CLK_TCK);
+    return {utime / ticks, stime / ticks};
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 5 && std::string{argv[1]} == "--stamp")
+        return stamp(argv[2], argv[3], std::atol(argv[4]));
+
+    auto exe = self();
+    auto energy = (argc > 1 && argv[1][0]) ? std::string{argv[1]} : exe.substr(0, exe.rfind('/') + 1) + "energy";
+    int programs = argc > 2 ? std::atoi(argv[2]) : 1000;
+    int seconds = argc > 3 ? std::atoi(argv[3]) : 20;
+    auto sleep_ms = argc > 4 ? argv[4] : "10000";
+
+    if (programs <= 0 || seconds <= 2) {
+        std::fprintf(stderr, "Usage: %s [ENERGY] [PROGRAMS] [SECONDS > 2] [SLEEP_MS]\n", argv[0]);
+        return 1;
+    }
+
+    if (access(energy.c_str(), X_OK) < 0) {
+        std::perror(energy.c_str());
+        return 1;
+    }
+
+    char file[] = "/tmp/bench_restart.XXXXXX";
+    int fd = mkstemp(file);
+    if (fd < 0) {
+        std::perror("mkstemp");
+        return 1;
+    }
+
+    close(fd);
+
+    std::vector<std::string> args = {energy, "--repeat=1000000", "--info=none"};
+    for (int i = 0; i < programs; ++i) {
+        for (auto arg : {std::string{"--"}, std::string{"!"}, exe, std::string{"--stamp"},
+                std::to_string(i), std::string{file}, std::string{sleep_ms}})
+            args.push_back(arg);
+    }
+
+    std::vector<char*> cargs;
+    for (auto &a : args)
+        cargs.push_back(&a[0]);
+
+    cargs.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, 1);
+
+        execv(cargs[0], cargs.data());
+        std::perror("execv");
+        _exit(127);
+    } else if (pid < 0) {
+        std::perror("fork");
+        return 1;
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds{seconds});
+
+    auto watcher = cpu_time(pid);
+
+    kill(pid, SIGINT);
+    waitpid(pid, nullptr, 0);
+
+    /* The runs of every program, in the order of their start */
+    std::map<int, std::vector<std::pair<long long, long long>>> runs;
+    long long first = 0;
+
+    std::FILE *stamps = std::fopen(file, "r");
+    if (stamps) {
+        int slot;
+        long long start, end;
+
+        while (std::fscanf(stamps, "%d %lld %lld", &slot, &start, &end) == 3) {
+            runs[slot].emplace_back(start, end);
+
+            if (first == 0 || start < first)
+                first = start;
+        }
+
+        std::fclose(stamps);
+    }
+
+    unlink(file);
+
+    auto cutoff = first + (seconds - 2) * 1000000000LL;
+    std::vector<double> latencies;
+    size_t completed = 0;
+
+    for (auto &r : runs) {
+        auto &v = r.second;
+        std::sort(v.begin(), v.end());
+
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (v[i].second < cutoff)
+                completed++;
+
+            if (i > 0 && v[i].first < cutoff)
+                latencies.push_back((v[i].first - v[i - 1].second) / 1000.0);
+        }
+    }
+
+    std::printf("%d programs for %d s: %zu completed runs, watcher cpu user %.2f s system %.2f s\n",
+            programs, seconds, completed, watcher.first, watcher.second);
+
+    if (latencies.empty()) {
+        std::printf("No restarts\n");
+        return 1;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&latencies](double p) {
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+
+    std::printf("restart latency (%zu restarts): p50 %.0f us, p90 %.0f us, p99 %.0f us, max %.0f us\n",
+            latencies.size(), pct(0.5), pct(0.9), pct(0.99), latencies.back());
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * Cost of reading many small energystat-like files per batch, once with one
+ * pread per file (the synchronous path of consumed_energy_many()) and once
+ * with a single io_uring submission for all of them. The files are created
+ * in a synthetic procfs-style directory, by default on /tmp.
+ *
+ * Usage: bench_uring [DIR]
+ **/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "../src/uring.h"
+
+
+using Clock = std::chrono::steady_clock;
+
+/* The same sizes and ring that libeteam uses */
+static const size_t buf_size = 256;
+static const unsigned ring_entries = 256;
+
+static const char content[] = "123456789 23456789 3456789 456789\n";
+
+static std::vector<int> create_files(const std::string &dir, size_t n)
+{
+    std::vector<int> fds;
+
+    for (size_t i = 0; i < n; ++i) {
+        std::string task = dir + "/" + std::to_string(i + 1);
+        std::string path = task + "/energystat";
+
+        ::mkdir(task.c_str(), 0755);
+
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0 || ::write(fd, content, sizeof(content) - 1) < 0) {
+            std::perror("creating the files failed");
+            std::exit(1);
+        }
+
+        fds.push_back(fd);
+    }
+
+    return fds;
+}
+
+static void remove_files(const std::string &dir, const std::vector<int> &fds)
+{
+    for (size_t i = 0; i < fds.size(); ++i) {
+        std::string task = dir + "/" + std::to_string(i + 1);
+
+        ::close(fds[i]);
+        ::unlink((task + "/energystat").c_str());
+        ::rmdir(task.c_str());
+    }
+}
+
+static void pread_all(const std::vector<int> &fds, char *bufs, ssize_t *res)
+{
+    for (size_t i = 0; i < fds.size(); ++i)
+        res[i] = ::pread(fds[i], bufs + i * buf_size, buf_size, 0);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string base = (argc > 1) ? argv[1] : "/tmp";
+    std::string dir = base + "/bench_uring." + std::to_string(getpid());
+
+    if (::mkdir(dir.c_str(), 0755) < 0) {
+        std::perror("mkdir");
+        return 1;
+    }
+
+    /* We need one file descriptor per pid */
+    struct rlimit lim;
+    ::getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &lim);
+
+    struct uring ring;
+    bool have_ring = uring_init(&ring, ring_entries) == 0;
+
+    if (!have_ring)
+        std::perror("io_uring is not available");
+
+    std::printf("%8s %14s %14s\n", "pids", "pread", "io_uring");
+
+    for (size_t n : {10, 100, 1000, 10000}) {
+        if (n + 16 > lim.rlim_cur) {
+            std::printf("%8zu skipped, only %llu files can be opened\n", n,
+                    static_cast<unsigned long long>(lim.rlim_cur));
+            continue;
+        }
+
+        auto fds = create_files(dir, n);
+        std::vector<char> bufs(n * buf_size);
+        std::vector<ssize_t> res(n);
+
+        /* About 2M reads in total */
+        size_t iters = 2000000 / n;
+
+        auto start = Clock::now();
+        for (size_t i = 0; i < iters; ++i)
+            pread_all(fds, bufs.data(), res.data());
+        std::chrono::duration<double, std::micro> sync = Clock::now() - start;
+
+        std::printf("%8zu %8.3f us/pid", n, sync.count() / iters / n);
+
+        if (have_ring) {
+            start = Clock::now();
+            for (size_t i = 0; i < iters; ++i)
+                uring_read_all(&ring, fds.data(), bufs.data(), buf_size, res.data(), n);
+            std::chrono::duration<double, std::micro> async = Clock::now() - start;
+
+            std::printf(" %8.3f us/pid", async.count() / iters / n);
+        }
+
+        std::printf("\n");
+
+        remove_files(dir, fds);
+    }
+
+    if (have_ring)
+        uring_destroy(&ring);
+
+    ::rmdir(dir.c_str());
+
+    return 0;
+}
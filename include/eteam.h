@@ -4,6 +4,7 @@
 
 #include <linux/types.h>
 
+#include <stddef.h>
 #include <unistd.h>
 
 
@@ -66,6 +67,294 @@ extern int stop_energy(pid_t pid);
  */
 extern int consumed_energy(pid_t pid, struct energy *energy);
 
+
+/**
+ * Get the consumed energy of a single thread of a process.
+ *
+ * @param[in] pid:      The pid of the process the thread belongs to. Use '0' to
+ *                      refer to the currently running process.
+ * @param[in] tid:      The id of the thread. Use '0' to refer to the calling
+ *                      thread.
+ * @param[out] energy:  Pointer to the &struct energy data structure where the final
+ *                      value should be saved in.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+extern int consumed_energy_thread(pid_t pid, pid_t tid, struct energy *energy);
+
+/**
+ * Get the ids of all threads of a process.
+ *
+ * @param[in] pid:      The pid of the process. Use '0' to refer to the currently
+ *                      running process.
+ * @param[out] tids:    Array where the thread ids should be saved in.
+ * @param[in] n:        The number of entries in the array. If the process has
+ *                      more threads, only the first n are saved.
+ *
+ * @returns:            The number of threads of the process (which may be larger
+ *                      than n), -1 on error (setting errno accordingly)
+ **/
+extern int eteam_threads(pid_t pid, pid_t *tids, size_t n);
+
+/**
+ * Get the consumed energy for the process with the given pid from the shared
+ * memory segment of 'energy --publish'. Other than consumed_energy(), this
+ * does not need a single system call (except for the very first call). The
+ * first query of a process registers it with the publisher, which provides
+ * values for it from its next round on.
+ *
+ * @param[in] pid:      The pid of the process for which the consumed energy should
+ *                      be returned. Use '0' to refer to the currently running
+ *                      process.
+ * @param[out] energy:  Pointer to the &struct energy data structure where the final
+ *                      value should be saved in.
+ * @param[out] age:     Optional pointer where the age of the value (in ns) should be
+ *                      saved in.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly).
+ *                      errno is ENOENT if no publisher is running, EAGAIN if
+ *                      there is no value for the process yet and ESTALE if the
+ *                      value is older than two publish intervals (energy and age
+ *                      are set nevertheless).
+ **/
+extern int consumed_energy_shm(pid_t pid, struct energy *energy, unsigned long long *age);
+
+/**
+ * Opaque handle to the energy statistics of a single process. The handle keeps
+ * the underlying procfs file open, so that repeated reads are only a single
+ * system call and never allocate any memory.
+ **/
+struct eteam_handle;
+
+/**
+ * Open a handle to the energy statistics of the process with the given pid.
+ *
+ * @param[in] pid:      The pid of the process whose energy should be read. Use
+ *                      '0' to get the library wide cached handle of the calling
+ *                      process. This handle stays valid across fork() and then
+ *                      always refers to the child.
+ *
+ * @returns:            The handle on success, NULL on error (setting errno
+ *                      accordingly)
+ **/
+extern struct eteam_handle *eteam_open(pid_t pid);
+
+/**
+ * Read the consumed energy via a handle previously opened with eteam_open().
+ *
+ * @param[in] handle:   The handle of the process.
+ * @param[out] energy:  Pointer to the &struct energy data structure where the final
+ *                      value should be saved in.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+extern int eteam_read(struct eteam_handle *handle, struct energy *energy);
+
+/* Enough to hold the energy statistics of a process for eteam_read_buf(). */
+#define ETEAM_READ_BUF_SIZE 256
+
+/**
+ * Like eteam_read(), but reads the procfs file into a buffer owned by the
+ * caller and parses it from there.
+ *
+ * @param[in] handle:   The handle of the process.
+ * @param[in] buf:      The buffer for the raw file content.
+ * @param[in] size:     The size of the buffer, ETEAM_READ_BUF_SIZE is enough.
+ * @param[out] energy:  Pointer to the &struct energy data structure where the final
+ *                      value should be saved in.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+extern int eteam_read_buf(struct eteam_handle *handle, char *buf, size_t size, struct energy *energy);
+
+/**
+ * Close a handle previously opened with eteam_open(). Closing the cached handle
+ * of the calling process is a no-op.
+ *
+ * @param[in] handle:   The handle that should be closed.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+extern int eteam_close(struct eteam_handle *handle);
+
+
+/**
+ * Start energy measurements using E-Team for several processes at once.
+ *
+ * @param[in] pids:     Array with the pids of the processes for which energy
+ *                      should be measured. '0' refers to the current process.
+ * @param[in] n:        The number of pids in the array.
+ * @param[out] errors:  Optional array with n entries, which receives 0 for every
+ *                      process that succeeded and the errno value otherwise.
+ *
+ * @returns:            The number of processes for which the measurement could
+ *                      not be started, -1 on error (setting errno accordingly)
+ **/
+extern int start_energy_many(const pid_t *pids, size_t n, int *errors);
+
+/**
+ * Stop E-Team based energy measurements for several processes at once.
+ *
+ * @param[in] pids:     Array with the pids of the processes for which energy
+ *                      should not be measured anymore. '0' refers to the
+ *                      current process.
+ * @param[in] n:        The number of pids in the array.
+ * @param[out] errors:  Optional array with n entries, which receives 0 for every
+ *                      process that succeeded and the errno value otherwise.
+ *
+ * @returns:            The number of processes for which the measurement could
+ *                      not be stopped, -1 on error (setting errno accordingly)
+ **/
+extern int stop_energy_many(const pid_t *pids, size_t n, int *errors);
+
+/**
+ * Get the consumed energy for several processes in one pass. The library keeps
+ * the energystat files of the queried processes open between calls, so that
+ * periodically querying the same set of processes only costs one read per
+ * process. Files of processes which were not queried for a while are closed
+ * again automatically.
+ *
+ * @param[in] pids:     Array with the pids of the processes for which the
+ *                      consumed energy should be returned. '0' refers to the
+ *                      current process.
+ * @param[in] n:        The number of pids in the array.
+ * @param[out] energies: Array with n entries where the values should be saved in.
+ * @param[out] errors:  Optional array with n entries, which receives 0 for every
+ *                      process that succeeded and the errno value otherwise.
+ *
+ * @returns:            The number of processes for which the energy could not be
+ *                      read, -1 on error (setting errno accordingly)
+ **/
+extern int consumed_energy_many(const pid_t *pids, size_t n, struct energy *energies,
+        int *errors);
+
+
+/**
+ * Get the consumed energy of the whole process tree starting at the process
+ * with the given pid. This sums up the energy of all threads of the process
+ * and of all its (transitive) children which are currently alive.
+ *
+ * @param[in] pid:      The pid of the root of the process tree. Use '0' to
+ *                      refer to the currently running process.
+ * @param[out] energy:  Pointer to the &struct energy data structure where the final
+ *                      value should be saved in.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+extern int consumed_energy_tree(pid_t pid, struct energy *energy);
+
+
+/**
+ * Opaque handle to a process tree. Other than consumed_energy_tree(), the
+ * handle remembers the energy of threads and children which exited since the
+ * last read, and keeps following descendants which were reparented since
+ * their parent exited. Energy which was consumed by a task after the last
+ * read and before it exited can not be seen anymore, hence the tree should be
+ * read regularly (or the tasks must not be reaped before the read, e.g. with
+ * the reading process as their subreaper).
+ **/
+struct eteam_tree;
+
+/**
+ * Start tracking the process tree starting at the process with the given pid.
+ *
+ * @param[in] pid:      The pid of the root of the process tree. Use '0' to
+ *                      refer to the currently running process.
+ *
+ * @returns:            The handle on success, NULL on error (setting errno
+ *                      accordingly)
+ **/
+extern struct eteam_tree *eteam_tree_open(pid_t pid);
+
+/**
+ * Get the consumed energy of the process tree including all tasks that
+ * exited since the tree was opened.
+ *
+ * @param[in] tree:     The handle of the process tree.
+ * @param[out] energy:  Pointer to the &struct energy data structure where the final
+ *                      value should be saved in.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+extern int eteam_tree_read(struct eteam_tree *tree, struct energy *energy);
+
+/**
+ * Get the pids of all processes of the tree that were seen at the last
+ * eteam_tree_open() or eteam_tree_read().
+ *
+ * @param[in] tree:     The handle of the process tree.
+ * @param[out] pids:    Array where the pids should be saved in.
+ * @param[in] n:        The number of entries in the array. If the tree has
+ *                      more processes, only the first n are saved.
+ *
+ * @returns:            The number of processes of the tree (which may be
+ *                      larger than n), -1 on error (setting errno accordingly)
+ **/
+extern int eteam_tree_pids(struct eteam_tree *tree, pid_t *pids, size_t n);
+
+/**
+ * Stop tracking a process tree and release the handle.
+ *
+ * @param[in] tree:     The handle that should be closed.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+extern int eteam_tree_close(struct eteam_tree *tree);
+
+
+/* Flags for eteam_profile_start() and eteam_profile_report() */
+#define ETEAM_PROFILE_CSV 0x1   /* Write the report as csv */
+
+/**
+ * Enter a named region of the in-process profiler. The profiler accumulates
+ * the energy of the calling thread, its CPU time and the number of calls per
+ * region and thread. Regions can be nested, in which case the report contains
+ * the inclusive and exclusive (without nested regions) values. All
+ * bookkeeping is thread-local, hence the functions can be used concurrently
+ * by any number of threads without contention.
+ *
+ * @param[in] name:     The name of the region. The pointer must stay valid
+ *                      until the end of the process (e.g. a string literal).
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly).
+ *                      eteam_region_exit() must be called nevertheless. If
+ *                      the regions are nested too deeply (ENOSPC), the region
+ *                      is not recorded and its values are part of the
+ *                      innermost region that is.
+ **/
+extern int eteam_region_enter(const char *name);
+
+/**
+ * Leave the region of the profiler that was entered last by the calling
+ * thread.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+extern int eteam_region_exit(void);
+
+/**
+ * Write a profiler report when the process exits.
+ *
+ * @param[in] path:     The file the report should be written to. Use '-' for
+ *                      stderr.
+ * @param[in] flags:    Flags for the report format (ETEAM_PROFILE_*)
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+extern int eteam_profile_start(const char *path, int flags);
+
+/**
+ * Immediately write a report of all regions recorded so far, sorted by the
+ * inclusive package energy.
+ *
+ * @param[in] path:     The file the report should be written to. Use '-' for
+ *                      stderr.
+ * @param[in] flags:    Flags for the report format (ETEAM_PROFILE_*)
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+extern int eteam_profile_report(const char *path, int flags);
+
 #ifdef __cplusplus
 }
 #endif
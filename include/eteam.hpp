@@ -0,0 +1,305 @@
+#ifndef __ETEAM_HPP__
+#define __ETEAM_HPP__
+
+#include <chrono>
+#include <cstdio>
+
+#include <eteam.h>
+
+
+namespace eteam {
+
+class Joules;
+
+/**
+ * An amount of energy in micro joules as reported by E-Team.
+ **/
+class Microjoules
+{
+   private:
+    unsigned long long _value;
+
+   public:
+    constexpr Microjoules() :
+        _value{0}
+    {}
+
+    constexpr explicit Microjoules(unsigned long long value) :
+        _value{value}
+    {}
+
+    constexpr unsigned long long count() const
+    {
+        return _value;
+    }
+
+    constexpr Joules joules() const;
+
+    constexpr Microjoules operator+(Microjoules o) const
+    {
+        return Microjoules{_value + o._value};
+    }
+
+    constexpr Microjoules operator-(Microjoules o) const
+    {
+        return Microjoules{_value - o._value};
+    }
+
+    Microjoules &operator+=(Microjoules o)
+    {
+        _value += o._value;
+        return *this;
+    }
+
+    Microjoules &operator-=(Microjoules o)
+    {
+        _value -= o._value;
+        return *this;
+    }
+
+    constexpr bool operator==(Microjoules o) const
+    {
+        return _value == o._value;
+    }
+
+    constexpr bool operator<(Microjoules o) const
+    {
+        return _value < o._value;
+    }
+};
+
+/**
+ * An amount of energy in joules.
+ **/
+class Joules
+{
+   private:
+    double _value;
+
+   public:
+    constexpr Joules() :
+        _value{0}
+    {}
+
+    constexpr explicit Joules(double value) :
+        _value{value}
+    {}
+
+    constexpr double count() const
+    {
+        return _value;
+    }
+
+    constexpr Microjoules microjoules() const
+    {
+        return Microjoules{static_cast<unsigned long long>(_value * 1000000.0 + 0.5)};
+    }
+};
+
+constexpr Joules Microjoules::joules() const
+{
+    return Joules{_value / 1000000.0};
+}
+
+/**
+ * A power in watts, i.e. an amount of energy over a duration.
+ **/
+class Watts
+{
+   private:
+    double _value;
+
+   public:
+    constexpr Watts() :
+        _value{0}
+    {}
+
+    constexpr explicit Watts(double value) :
+        _value{value}
+    {}
+
+    constexpr double count() const
+    {
+        return _value;
+    }
+};
+
+template <typename Rep, typename Period>
+constexpr Watts operator/(Joules e, std::chrono::duration<Rep, Period> d)
+{
+    return Watts{e.count() / std::chrono::duration_cast<std::chrono::duration<double>>(d).count()};
+}
+
+template <typename Rep, typename Period>
+constexpr Watts operator/(Microjoules e, std::chrono::duration<Rep, Period> d)
+{
+    return e.joules() / d;
+}
+
+/**
+ * The energy of all domains in a strongly typed fashion.
+ **/
+struct Energy
+{
+    Microjoules package;
+    Microjoules core;
+    Microjoules dram;
+    Microjoules gpu;
+
+    constexpr Energy operator-(const Energy &o) const
+    {
+        return Energy{package - o.package, core - o.core, dram - o.dram, gpu - o.gpu};
+    }
+
+    Energy &operator+=(const Energy &o)
+    {
+        package += o.package;
+        core += o.core;
+        dram += o.dram;
+        gpu += o.gpu;
+
+        return *this;
+    }
+};
+
+/**
+ * Read the energy of the calling process via the cached handle of libeteam.
+ * Returns zero if E-Team is not available.
+ **/
+inline Energy current_energy()
+{
+    static eteam_handle *handle = eteam_open(0);
+    struct energy e;
+
+    if (!handle || eteam_read(handle, &e) < 0)
+        return Energy{};
+
+    return Energy{Microjoules{e.package}, Microjoules{e.core}, Microjoules{e.dram}, Microjoules{e.gpu}};
+}
+
+
+/**
+ * Measurement policy which removes all instrumentation.
+ **/
+struct NoProfiling
+{
+    static constexpr bool enabled = false;
+
+    static void report(const char *, const Energy &)
+    {}
+};
+
+/**
+ * Measurement policy which measures every region and prints its energy to
+ * stderr. Write your own policy with a different report() function to process
+ * the values differently.
+ **/
+struct Profiling
+{
+    static constexpr bool enabled = true;
+
+    static void report(const char *name, const Energy &e)
+    {
+        std::fprintf(stderr, "eteam: %s: pkg=%llu core=%llu dram=%llu gpu=%llu (uJ)\n", name,
+                e.package.count(), e.core.count(), e.dram.count(), e.gpu.count());
+    }
+};
+
+/**
+ * Measurement policy which records every region in the in-process profiler
+ * of libeteam (see eteam_region_enter()).
+ **/
+struct Profiler
+{
+    static constexpr bool enabled = true;
+};
+
+#ifdef ETEAM_PROFILING
+using DefaultPolicy = Profiling;
+#else
+using DefaultPolicy = NoProfiling;
+#endif
+
+
+/**
+ * Measure the energy consumption of the calling process during the lifetime of
+ * the object, and report it via the policy at the end.
+ *
+ *     {
+ *         eteam::Region r{"parse"};
+ *         ...
+ *     }
+ **/
+template <typename Policy, bool Enabled = Policy::enabled>
+class BasicRegion
+{
+   private:
+    const char *_name;
+    Energy _start;
+
+   public:
+    explicit BasicRegion(const char *name) :
+        _name{name}, _start{current_energy()}
+    {}
+
+    BasicRegion(const BasicRegion &) = delete;
+    BasicRegion &operator=(const BasicRegion &) = delete;
+
+    ~BasicRegion()
+    {
+        Policy::report(_name, consumed());
+    }
+
+    /* The energy consumed since the beginning of the region */
+    Energy consumed() const
+    {
+        return current_energy() - _start;
+    }
+};
+
+template <typename Policy>
+class BasicRegion<Policy, false>
+{
+   public:
+    constexpr explicit BasicRegion(const char *)
+    {}
+
+    BasicRegion(const BasicRegion &) = delete;
+    BasicRegion &operator=(const BasicRegion &) = delete;
+
+    constexpr Energy consumed() const
+    {
+        return Energy{};
+    }
+};
+
+template <>
+class BasicRegion<Profiler, true>
+{
+   public:
+    explicit BasicRegion(const char *name)
+    {
+        eteam_region_enter(name);
+    }
+
+    BasicRegion(const BasicRegion &) = delete;
+    BasicRegion &operator=(const BasicRegion &) = delete;
+
+    ~BasicRegion()
+    {
+        eteam_region_exit();
+    }
+};
+
+using Region = BasicRegion<DefaultPolicy>;
+
+} /* namespace eteam */
+
+
+#define __ETEAM_CONCAT_(a, b) a ## b
+#define __ETEAM_CONCAT(a, b) __ETEAM_CONCAT_(a, b)
+
+/* Measure the rest of the current scope as a region with the given name. */
+#define ETEAM_REGION(name) ::eteam::Region __ETEAM_CONCAT(__eteam_region_, __LINE__){name}
+
+#endif /* __ETEAM_HPP__ */
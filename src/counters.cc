@@ -0,0 +1,189 @@
+#include "counters.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include <linux/perf_event.h>
+
+#include "topology.h"
+
+
+const std::string Counters::pmu_root = {"/sys/bus/event_source/devices"};
+
+static int perf_event_open(perf_event_attr &attr, pid_t pid, int cpu, int group)
+{
+    return syscall(SYS_perf_event_open, &attr, pid, cpu, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+static std::string read_line(const std::string &path)
+{
+    std::ifstream file{path};
+    std::string line;
+
+    std::getline(file, line);
+    return line;
+}
+
+/* Read a counter and scale it up if it was multiplexed with others */
+static unsigned long long read_scaled(int fd)
+{
+    /* value, time enabled, time running */
+    unsigned long long buf[3];
+
+    if (::read(fd, buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0)
+        return 0;
+
+    if (buf[1] == buf[2])
+        return buf[0];
+
+    return static_cast<unsigned long long>(static_cast<double>(buf[0]) * buf[1] / buf[2]);
+}
+
+Counters::Counters(pid_t pid, bool uncore, bool on_exec, const std::string &root) :
+    _fds{}, _uncore{}
+{
+    static const unsigned long long events[] = {
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    for (auto event : events) {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = event;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1;
+        attr.exclude_hv = 1;
+
+        /* Only the leader is disabled, the group is enabled together with it */
+        attr.disabled = _fds.empty();
+        attr.enable_on_exec = on_exec && _fds.empty();
+
+        int fd = perf_event_open(attr, pid, -1, _fds.empty() ? -1 : _fds.front());
+        if (fd < 0) {
+            /* Without the first counters the others are pointless */
+            if (_fds.empty())
+                return;
+
+            /* Keep the position of the event, it reads as zero */
+            _fds.push_back(-1);
+            continue;
+        }
+
+        _fds.push_back(fd);
+    }
+
+    if (uncore)
+        open_uncore(root);
+}
+
+Counters::~Counters()
+{
+    for (auto fd : _fds) {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    for (auto &u : _uncore)
+        close(u.fd);
+}
+
+void Counters::open_uncore(const std::string &root)
+{
+    DIR *dir = opendir(root.c_str());
+    if (!dir)
+        return;
+
+    struct dirent *entry;
+
+    /* One memory controller PMU per channel, e.g. 'uncore_imc_0' */
+    while ((entry = readdir(dir))) {
+        std::string pmu = root + "/" + entry->d_name;
+
+        if (std::string{entry->d_name}.compare(0, 11, "uncore_imc_") != 0)
+            continue;
+
+        auto type = read_line(pmu + "/type");
+        /* The PMU counts for its whole package on one CPU each */
+        auto cpus = topology::parse_cpus(read_line(pmu + "/cpumask"));
+
+        for (auto name : {"cas_count_read", "cas_count_write"}) {
+            std::string event = pmu + "/events/" + name;
+            unsigned int ev, umask;
+
+            if (std::sscanf(read_line(event).c_str(), "event=%x,umask=%x", &ev, &umask) != 2)
+                continue;
+
+            double scale = std::strtod(read_line(event + ".scale").c_str(), nullptr);
+
+            perf_event_attr attr{};
+            attr.type = std::strtoul(type.c_str(), nullptr, 10);
+            attr.size = sizeof(attr);
+            attr.config = ev | (umask << 8);
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.disabled = 1;
+
+            for (auto cpu : cpus) {
+                int fd = perf_event_open(attr, -1, cpu, -1);
+                if (fd >= 0)
+                    _uncore.push_back(Uncore{fd, scale, name[10] == 'w'});
+            }
+        }
+    }
+
+    closedir(dir);
+}
+
+void Counters::enable()
+{
+    if (!_fds.empty())
+        ioctl(_fds.front(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    for (auto &u : _uncore)
+        ioctl(u.fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void Counters::disable()
+{
+    if (!_fds.empty())
+        ioctl(_fds.front(), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    for (auto &u : _uncore)
+        ioctl(u.fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+void Counters::reset()
+{
+    if (!_fds.empty())
+        ioctl(_fds.front(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+
+    for (auto &u : _uncore)
+        ioctl(u.fd, PERF_EVENT_IOC_RESET, 0);
+}
+
+CounterValues Counters::read() const
+{
+    CounterValues v{};
+    unsigned long long *values[] = {&v.instructions, &v.cycles, &v.cache_misses, &v.branch_misses};
+
+    for (size_t i = 0; i < _fds.size(); ++i) {
+        if (_fds[i] >= 0)
+            *values[i] = read_scaled(_fds[i]);
+    }
+
+    for (auto &u : _uncore)
+        (u.write ? v.mem_write : v.mem_read) += read_scaled(u.fd) * u.scale;
+
+    return v;
+}
@@ -0,0 +1,73 @@
+#ifndef __COUNTERS_H__
+#define __COUNTERS_H__
+
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+
+/**
+ * The hardware counter values of a measured process. Counters that could not
+ * be opened are zero.
+ **/
+struct CounterValues
+{
+    unsigned long long instructions;
+    unsigned long long cycles;
+    unsigned long long cache_misses;    /* last level cache */
+    unsigned long long branch_misses;
+
+    /* Memory traffic of the whole system (in MiB), only with uncore counters */
+    double mem_read;
+    double mem_write;
+};
+
+/**
+ * Hardware performance counters of a process, including all of its threads and
+ * descendants that are created after the counters were opened. The counters
+ * start disabled and only count while they are enabled, or, with on_exec, as
+ * soon as the process executes a new program.
+ **/
+class Counters
+{
+   public:
+    /* Default location of the perf PMUs in sysfs */
+    static const std::string pmu_root;
+
+   private:
+    /* One group of the hardware events (the first one is the leader) */
+    std::vector<int> _fds;
+
+    /* System wide memory controller events */
+    struct Uncore {
+        int fd;
+        double scale;
+        bool write;
+    };
+
+    std::vector<Uncore> _uncore;
+
+    void open_uncore(const std::string &root);
+
+   public:
+    Counters(pid_t pid, bool uncore, bool on_exec=false, const std::string &root=pmu_root);
+    Counters(const Counters&) = delete;
+
+    ~Counters();
+
+    Counters& operator=(const Counters&) = delete;
+
+    bool available() const
+    {
+        return !_fds.empty();
+    }
+
+    void enable();
+    void disable();
+    void reset();
+
+    CounterValues read() const;
+};
+
+#endif /* __COUNTERS_H__ */
@@ -0,0 +1,40 @@
+#ifndef __ENERGYSTAT_H__
+#define __ENERGYSTAT_H__
+
+#include <eteam.h>
+
+#include <unistd.h>
+
+
+/* Internal helpers of libeteam, which are shared between its modules but are
+ * not part of the public interface in eteam.h. They are prefixed to not clash
+ * with the symbols of programs that link the static library, and hidden in a
+ * shared one. */
+#define ETEAM_INTERNAL __attribute__((visibility("hidden")))
+
+/* Enough to hold the whole energystat file of a process. */
+#define ENERGYSTAT_BUF_SIZE ETEAM_READ_BUF_SIZE
+
+/**
+ * Open the energystat file of the thread tid of the process pid.
+ *
+ * @returns:            The file descriptor on success, -1 on error (setting
+ *                      errno accordingly)
+ **/
+ETEAM_INTERNAL int __eteam_energystat_open_task(pid_t pid, pid_t tid);
+
+/**
+ * Read and parse an energystat file which was opened before.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+ETEAM_INTERNAL int __eteam_energystat_read(int fd, struct energy *energy);
+
+/**
+ * Like __eteam_energystat_read(), but with the buffer of the caller.
+ *
+ * @returns:            0 on success, -1 on error (setting errno accordingly)
+ **/
+ETEAM_INTERNAL int __eteam_energystat_read_buf(int fd, char *buf, size_t size, struct energy *energy);
+
+#endif /* __ENERGYSTAT_H__ */
@@ -0,0 +1,72 @@
+#include "estimate.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+
+/* 97.5% quantiles of Student's t-distribution for 1 to 30 degrees of freedom */
+static const double t_quantiles[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+static double t_quantile(size_t df)
+{
+    if (df <= sizeof(t_quantiles) / sizeof(t_quantiles[0]))
+        return t_quantiles[df - 1];
+
+    /* Close enough to the normal distribution */
+    return 1.96;
+}
+
+static Interval ratio_estimate(const std::vector<Window> &windows, unsigned long long Energy::*domain,
+        double total_time)
+{
+    double energy = 0, time = 0;
+
+    for (auto &w : windows) {
+        energy += w.energy.*domain;
+        time += w.time;
+    }
+
+    size_t n = windows.size();
+
+    /* Without any CPU time in the windows there is nothing to extrapolate from */
+    if (time <= 0)
+        return Interval{energy, std::numeric_limits<double>::quiet_NaN()};
+
+    double ratio = energy / time;
+    double value = ratio * total_time;
+
+    if (n < 2)
+        return Interval{value, std::numeric_limits<double>::quiet_NaN()};
+
+    /* Variance of the residuals of the windows around the common ratio */
+    double residuals = 0;
+
+    for (auto &w : windows) {
+        double r = w.energy.*domain - ratio * w.time;
+        residuals += r * r;
+    }
+
+    double variance = residuals / (n - 1);
+    double mean_time = time / n;
+    double fraction = total_time > time ? time / total_time : 1.0;
+
+    double ratio_error = std::sqrt((1.0 - fraction) * variance / n) / mean_time;
+
+    return Interval{value, t_quantile(n - 1) * ratio_error * total_time};
+}
+
+Estimate estimate(const std::vector<Window> &windows, double total_time)
+{
+    return Estimate{
+        ratio_estimate(windows, &Energy::package, total_time),
+        ratio_estimate(windows, &Energy::core, total_time),
+        ratio_estimate(windows, &Energy::dram, total_time),
+        ratio_estimate(windows, &Energy::gpu, total_time),
+        windows.size()
+    };
+}
@@ -0,0 +1,48 @@
+#ifndef __ESTIMATE_H__
+#define __ESTIMATE_H__
+
+#include <cstddef>
+#include <vector>
+
+#include "energy.h"
+
+
+/* The energy and the CPU time (in s) of one measured sampling window */
+struct Window
+{
+    Energy energy;
+    double time;
+};
+
+/* An estimated value and the half width of its 95% confidence interval */
+struct Interval
+{
+    double value;
+    double error;
+};
+
+/**
+ * The energy of a whole run extrapolated from the sampled windows. The error
+ * is NaN if there are not enough windows to compute it.
+ **/
+struct Estimate
+{
+    Interval package;
+    Interval core;
+    Interval dram;
+    Interval gpu;
+
+    size_t windows;
+};
+
+/**
+ * Extrapolate the energy of a run that used the given CPU time in total from
+ * the measured windows. This is a ratio estimator: the energy per CPU second
+ * of the windows is multiplied by the total CPU time. The confidence interval
+ * follows from the variance of the energy per CPU second between the windows
+ * (with finite population correction, so it shrinks to zero if everything was
+ * measured).
+ **/
+Estimate estimate(const std::vector<Window> &windows, double total_time);
+
+#endif /* __ESTIMATE_H__ */
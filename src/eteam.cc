@@ -2,11 +2,707 @@
 
 #include <linux/types.h>
 
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/syscall.h>
 
+#include "energystat.h"
+
+#ifdef ETEAM_IO_URING
+#include "uring.h"
+#endif
+
+
+struct eteam_handle {
+    int fd;
+    pid_t pid;      /* 0 for the cached handle of the calling process */
+};
+
+/* Enough to hold the list of children of a single task. */
+#define CHILDREN_BUF_SIZE 4096
+
+struct task_energy {
+    pid_t pid;                  /* the process the task belongs to */
+    pid_t tid;
+    unsigned long long start;   /* in clock ticks after boot, tells reused tids apart */
+    struct energy energy;
+};
+
+/* A growable array of task energies */
+struct task_list {
+    struct task_energy *tasks;
+    size_t count;
+    size_t size;
+};
+
+struct eteam_tree {
+    pid_t pid;
+
+    struct task_list last;      /* The tasks seen at the last read, sorted by tid */
+    struct energy exited;       /* The energy of all tasks that exited since */
+};
+
+/* The cached handle of the calling process. The file is opened lazily and
+ * closed again in the child after a fork. */
+static struct eteam_handle self_handle = { -1, 0 };
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+/* Initial number of slots in the pid cache (must be a power of two). */
+#define PID_CACHE_INIT_SIZE 64
+
+/* Number of batched queries after which an unused cache entry is closed. */
+#define PID_CACHE_MAX_AGE 8
+
+/* Number of entries of the io_uring submission queue. */
+#define URING_ENTRIES 256
+
+/* Below this number of processes, plain preads are at least as fast as a
+ * round trip through io_uring. */
+#define URING_MIN_BATCH 64
+
+enum uring_state {
+    URING_UNTRIED,
+    URING_READY,
+    URING_UNAVAILABLE
+};
+
+struct pid_cache_entry {
+    pid_t pid;      /* 0 for an empty slot */
+    int fd;
+    unsigned long used;
+};
+
+/* Cache of open energystat files used by the batched functions. It is an open
+ * addressing hash table with linear probing, protected by pid_cache_lock. */
+static struct {
+    struct pid_cache_entry *entries;
+    size_t size;
+    size_t count;
+    unsigned long generation;
+
+    /* Scratch space for the batched reads, grown on demand */
+    int *fds;
+    char *bufs;
+    ssize_t *res;
+    size_t scratch_size;
+
+#ifdef ETEAM_IO_URING
+    struct uring ring;
+    enum uring_state ring_state;
+#endif
+} pid_cache;
+static pthread_mutex_t pid_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static int open_energystat(pid_t pid)
+{
+    char path[100];
+
+    snprintf(path, 100, "/proc/%d/energystat", pid);
+
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+int __eteam_energystat_open_task(pid_t pid, pid_t tid)
+{
+    char path[100];
+
+    snprintf(path, 100, "/proc/%d/task/%d/energystat", pid, tid);
+
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+static const char *parse_ull(const char *cur, const char *end, unsigned long long *val)
+{
+    unsigned long long v = 0;
+
+    while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\n'))
+        cur++;
+
+    if (cur == end || *cur < '0' || *cur > '9')
+        return NULL;
+
+    while (cur < end && *cur >= '0' && *cur <= '9')
+        v = v * 10 + (*cur++ - '0');
+
+    *val = v;
+    return cur;
+}
+
+static int parse_energystat(const char *buf, ssize_t len, struct energy *energy)
+{
+    const char *cur, *end;
+
+    cur = buf;
+    end = buf + len;
+
+    /* The order of the values in the file is package, dram, core and gpu. */
+    if (!(cur = parse_ull(cur, end, &energy->package)) ||
+            !(cur = parse_ull(cur, end, &energy->dram)) ||
+            !(cur = parse_ull(cur, end, &energy->core)) ||
+            !(cur = parse_ull(cur, end, &energy->gpu))) {
+        errno = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+int __eteam_energystat_read_buf(int fd, char *buf, size_t size, struct energy *energy)
+{
+    ssize_t len;
+
+    len = pread(fd, buf, size, 0);
+    if (len < 0)
+        return -1;
+
+    return parse_energystat(buf, len, energy);
+}
+
+int __eteam_energystat_read(int fd, struct energy *energy)
+{
+    char buf[ENERGYSTAT_BUF_SIZE];
+
+    return __eteam_energystat_read_buf(fd, buf, ENERGYSTAT_BUF_SIZE, energy);
+}
+
+static void atfork_prepare(void)
+{
+    pthread_mutex_lock(&pid_cache_lock);
+}
+
+static void atfork_parent(void)
+{
+    pthread_mutex_unlock(&pid_cache_lock);
+}
+
+static void atfork_child(void)
+{
+    pthread_mutex_unlock(&pid_cache_lock);
+
+#ifdef ETEAM_IO_URING
+    /* The rings are shared memory with the parent, the child has to set up its
+     * own instance. */
+    if (pid_cache.ring_state == URING_READY)
+        uring_destroy(&pid_cache.ring);
+
+    pid_cache.ring_state = URING_UNTRIED;
+#endif
+
+    /* The child is single threaded at this point, and the inherited file
+     * still refers to the parent. */
+    if (self_handle.fd >= 0)
+        close(self_handle.fd);
+
+    self_handle.fd = -1;
+}
+
+static void atfork_init(void)
+{
+    pthread_atfork(atfork_prepare, atfork_parent, atfork_child);
+}
+
+static int self_handle_fd(void)
+{
+    int fd, expected;
+
+    fd = __atomic_load_n(&self_handle.fd, __ATOMIC_ACQUIRE);
+    if (fd >= 0)
+        return fd;
+
+    pthread_once(&atfork_once, atfork_init);
+
+    fd = open_energystat(getpid());
+    if (fd < 0)
+        return -1;
+
+    /* Another thread might have been faster -- use its file instead. */
+    expected = -1;
+    if (!__atomic_compare_exchange_n(&self_handle.fd, &expected, fd, 0,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        close(fd);
+        fd = expected;
+    }
+
+    return fd;
+}
+
+
+static size_t pid_cache_slot(pid_t pid, size_t size)
+{
+    return ((unsigned long)pid * 2654435761UL) & (size - 1);
+}
+
+static struct pid_cache_entry *pid_cache_find(pid_t pid)
+{
+    size_t i;
+
+    if (!pid_cache.entries)
+        return NULL;
+
+    for (i = pid_cache_slot(pid, pid_cache.size); pid_cache.entries[i].pid != 0;
+            i = (i + 1) & (pid_cache.size - 1)) {
+        if (pid_cache.entries[i].pid == pid)
+            return &pid_cache.entries[i];
+    }
+
+    return NULL;
+}
+
+static int pid_cache_grow(void)
+{
+    struct pid_cache_entry *entries;
+    size_t size, i, j;
+
+    size = pid_cache.size ? pid_cache.size * 2 : PID_CACHE_INIT_SIZE;
+
+    entries = (struct pid_cache_entry *)calloc(size, sizeof(*entries));
+    if (!entries)
+        return -1;
+
+    for (i = 0; i < pid_cache.size; ++i) {
+        if (pid_cache.entries[i].pid == 0)
+            continue;
+
+        for (j = pid_cache_slot(pid_cache.entries[i].pid, size); entries[j].pid != 0;
+                j = (j + 1) & (size - 1))
+            ;
+
+        entries[j] = pid_cache.entries[i];
+    }
+
+    free(pid_cache.entries);
+    pid_cache.entries = entries;
+    pid_cache.size = size;
+
+    return 0;
+}
+
+static struct pid_cache_entry *pid_cache_insert(pid_t pid, int fd)
+{
+    size_t i;
+
+    /* Keep the load factor below 1/2. */
+    if (2 * (pid_cache.count + 1) > pid_cache.size && pid_cache_grow() < 0)
+        return NULL;
+
+    for (i = pid_cache_slot(pid, pid_cache.size); pid_cache.entries[i].pid != 0;
+            i = (i + 1) & (pid_cache.size - 1))
+        ;
+
+    pid_cache.entries[i].pid = pid;
+    pid_cache.entries[i].fd = fd;
+    pid_cache.entries[i].used = pid_cache.generation;
+    pid_cache.count++;
+
+    return &pid_cache.entries[i];
+}
+
+static void pid_cache_remove(struct pid_cache_entry *entry)
+{
+    size_t i, j, k, mask;
+
+    close(entry->fd);
+
+    /* Close the gap by moving later entries of the same probe sequence back
+     * into it, so that lookups never need tombstones. */
+    mask = pid_cache.size - 1;
+    i = entry - pid_cache.entries;
+    j = i;
+
+    for (;;) {
+        pid_cache.entries[i].pid = 0;
+
+        do {
+            j = (j + 1) & mask;
+            if (pid_cache.entries[j].pid == 0) {
+                pid_cache.count--;
+                return;
+            }
+
+            k = pid_cache_slot(pid_cache.entries[j].pid, pid_cache.size);
+        } while (i <= j ? (i < k && k <= j) : (i < k || k <= j));
+
+        pid_cache.entries[i] = pid_cache.entries[j];
+        i = j;
+    }
+}
+
+static void pid_cache_expire(void)
+{
+    size_t i;
+
+    for (i = 0; i < pid_cache.size; ) {
+        struct pid_cache_entry *entry = &pid_cache.entries[i];
+
+        /* Removing an entry might move another one into this slot, hence
+         * only advance if nothing was removed. */
+        if (entry->pid != 0 && pid_cache.generation - entry->used > PID_CACHE_MAX_AGE)
+            pid_cache_remove(entry);
+        else
+            ++i;
+    }
+}
+
+/* Read the energy of a pid with a fresh file and replace the cached one with
+ * it. Must be called with pid_cache_lock held. */
+static int pid_cache_reopen(pid_t pid, struct energy *energy)
+{
+    struct pid_cache_entry *entry;
+    int fd;
+
+    entry = pid_cache_find(pid);
+    if (entry)
+        pid_cache_remove(entry);
+
+    fd = open_energystat(pid);
+    if (fd < 0)
+        return -1;
+
+    if (__eteam_energystat_read(fd, energy) < 0) {
+        int err = errno;
+
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    /* Failing to cache the file is not an error, we only lose the benefit of
+     * the cache for the next query. */
+    if (!pid_cache_insert(pid, fd))
+        close(fd);
+
+    return 0;
+}
+
+static int pid_cache_reserve(size_t n)
+{
+    int *fds;
+    char *bufs;
+    ssize_t *res;
+
+    if (n <= pid_cache.scratch_size)
+        return 0;
+
+    /* The file buffers are the largest of the scratch arrays */
+    if (n > SIZE_MAX / ENERGYSTAT_BUF_SIZE) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    fds = (int *)realloc(pid_cache.fds, n * sizeof(*fds));
+    if (!fds)
+        return -1;
+    pid_cache.fds = fds;
+
+    bufs = (char *)realloc(pid_cache.bufs, n * ENERGYSTAT_BUF_SIZE);
+    if (!bufs)
+        return -1;
+    pid_cache.bufs = bufs;
+
+    res = (ssize_t *)realloc(pid_cache.res, n * sizeof(*res));
+    if (!res)
+        return -1;
+    pid_cache.res = res;
+
+    pid_cache.scratch_size = n;
+
+    return 0;
+}
+
+/* Read the first chunk of all n files in the scratch space. */
+static void pid_cache_read_all(size_t n)
+{
+    size_t i;
+
+#ifdef ETEAM_IO_URING
+    if (n >= URING_MIN_BATCH) {
+        if (pid_cache.ring_state == URING_UNTRIED) {
+            if (uring_init(&pid_cache.ring, URING_ENTRIES) == 0)
+                pid_cache.ring_state = URING_READY;
+            else
+                pid_cache.ring_state = URING_UNAVAILABLE;
+        }
+
+        if (pid_cache.ring_state == URING_READY) {
+            /* Files which could not be opened are not submitted at all. */
+            if (uring_read_all(&pid_cache.ring, pid_cache.fds, pid_cache.bufs,
+                        ENERGYSTAT_BUF_SIZE, pid_cache.res, n) == 0)
+                return;
+
+            /* Something is wrong with the ring itself -- don't use it anymore
+             * and fall back to the synchronous path. */
+            uring_destroy(&pid_cache.ring);
+            pid_cache.ring_state = URING_UNAVAILABLE;
+        }
+    }
+#endif
+
+    for (i = 0; i < n; ++i) {
+        ssize_t len;
+
+        if (pid_cache.fds[i] < 0)
+            continue;
+
+        len = pread(pid_cache.fds[i], pid_cache.bufs + i * ENERGYSTAT_BUF_SIZE,
+                ENERGYSTAT_BUF_SIZE, 0);
+
+        pid_cache.res[i] = len < 0 ? -errno : len;
+    }
+}
+
+static void energy_add(struct energy *sum, const struct energy *e)
+{
+    sum->package += e->package;
+    sum->core += e->core;
+    sum->dram += e->dram;
+    sum->gpu += e->gpu;
+}
+
+static int task_list_append(struct task_list *list, pid_t pid, pid_t tid, unsigned long long start,
+        const struct energy *energy)
+{
+    if (list->count == list->size) {
+        size_t size = list->size ? list->size * 2 : 16;
+        struct task_energy *tasks;
+
+        tasks = (struct task_energy *)realloc(list->tasks, size * sizeof(*tasks));
+        if (!tasks)
+            return -1;
+
+        list->tasks = tasks;
+        list->size = size;
+    }
+
+    list->tasks[list->count].pid = pid;
+    list->tasks[list->count].tid = tid;
+    list->tasks[list->count].start = start;
+    list->tasks[list->count].energy = *energy;
+    list->count++;
+
+    return 0;
+}
+
+/* Read the start time of a task (field 22 of its stat file). */
+static int task_start_time(pid_t pid, pid_t tid, unsigned long long *start)
+{
+    char path[100];
+    char buf[512];
+    char *cur;
+    ssize_t len;
+    int fd, i;
+
+    snprintf(path, 100, "/proc/%d/task/%d/stat", pid, tid);
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+
+    if (len <= 0)
+        return -1;
+    buf[len] = '\0';
+
+    /* The command name (field 2) may contain spaces and parentheses, hence
+     * count the fields from the last closing parenthesis on. */
+    cur = strrchr(buf, ')');
+    for (i = 2; cur && i < 22; ++i)
+        cur = strchr(cur + 1, ' ');
+
+    if (!cur) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *start = strtoull(cur + 1, NULL, 10);
+
+    return 0;
+}
+
+static int task_energy_cmp(const void *a, const void *b)
+{
+    pid_t ta = ((const struct task_energy *)a)->tid;
+    pid_t tb = ((const struct task_energy *)b)->tid;
+
+    return (ta > tb) - (ta < tb);
+}
+
+/* Read the energy of all threads of the process with the given pid and append
+ * the pids of all their children to the work list. */
+static int walk_process(pid_t pid, struct task_list *tasks, pid_t **work, size_t *work_count,
+        size_t *work_size)
+{
+    char path[100];
+    char buf[CHILDREN_BUF_SIZE];
+    struct dirent *de;
+    DIR *dir;
+
+    snprintf(path, 100, "/proc/%d/task", pid);
+
+    dir = opendir(path);
+    if (!dir)
+        return -1;
+
+    while ((de = readdir(dir))) {
+        struct energy energy;
+        unsigned long long start;
+        pid_t tid;
+        char *cur;
+        ssize_t len;
+        int fd;
+
+        if (de->d_name[0] < '0' || de->d_name[0] > '9')
+            continue;
+
+        tid = (pid_t)strtol(de->d_name, NULL, 10);
+
+        if (task_start_time(pid, tid, &start) < 0)
+            continue;   /* The thread just exited */
+
+        fd = __eteam_energystat_open_task(pid, tid);
+        if (fd < 0)
+            continue;
+
+        if (__eteam_energystat_read(fd, &energy) == 0 &&
+                task_list_append(tasks, pid, tid, start, &energy) < 0) {
+            close(fd);
+            closedir(dir);
+            return -1;
+        }
+        close(fd);
+
+        snprintf(path, 100, "/proc/%d/task/%d/children", pid, tid);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        len = read(fd, buf, CHILDREN_BUF_SIZE - 1);
+        close(fd);
+
+        if (len <= 0)
+            continue;
+        buf[len] = '\0';
+
+        for (cur = buf; *cur; ) {
+            char *end;
+            long child = strtol(cur, &end, 10);
+
+            if (end == cur)
+                break;
+            cur = end;
+
+            if (*work_count == *work_size) {
+                size_t size = *work_size ? *work_size * 2 : 16;
+                pid_t *w = (pid_t *)realloc(*work, size * sizeof(*w));
+
+                if (!w) {
+                    closedir(dir);
+                    return -1;
+                }
+
+                *work = w;
+                *work_size = size;
+            }
+
+            (*work)[(*work_count)++] = (pid_t)child;
+        }
+    }
+
+    closedir(dir);
+
+    return 0;
+}
+
+/* Append the energy of all tasks in the process tree starting at pid to the
+ * list. */
+static int walk_subtree(pid_t pid, struct task_list *tasks)
+{
+    pid_t *work = NULL;
+    size_t work_count = 0, work_size = 0;
+    int ret = 0;
+
+    if (walk_process(pid, tasks, &work, &work_count, &work_size) < 0) {
+        free(work);
+        return -1;
+    }
+
+    while (work_count > 0) {
+        /* Descendants which exit while we walk the tree are simply skipped. */
+        if (walk_process(work[--work_count], tasks, &work, &work_count, &work_size) < 0 &&
+                errno == ENOMEM) {
+            ret = -1;
+            break;
+        }
+    }
+
+    free(work);
+
+    return ret;
+}
+
+/* Read the energy of all tasks in the process tree starting at pid. The
+ * resulting list is sorted by tid. */
+static int walk_tree(pid_t pid, struct task_list *tasks)
+{
+    tasks->count = 0;
+
+    if (walk_subtree(pid, tasks) < 0)
+        return -1;
+
+    qsort(tasks->tasks, tasks->count, sizeof(*tasks->tasks), task_energy_cmp);
+
+    return 0;
+}
+
+/* Find a task in a list that is sorted by tid. */
+static const struct task_energy *task_list_find(const struct task_list *list, pid_t tid)
+{
+    struct task_energy key;
+
+    key.tid = tid;
+
+    if (list->count == 0)
+        return NULL;
+
+    return (const struct task_energy *)bsearch(&key, list->tasks, list->count, sizeof(key),
+            task_energy_cmp);
+}
+
+/* Walk the processes of the last read again which can not be reached from the
+ * root anymore, since their parent exited and they were reparented to init
+ * (or a subreaper). The list stays sorted by tid. */
+static int walk_orphans(const struct task_list *last, struct task_list *cur)
+{
+    size_t i;
+
+    for (i = 0; i < last->count; ++i) {
+        const struct task_energy *old = &last->tasks[i];
+        unsigned long long start;
+
+        if (old->tid != old->pid || task_list_find(cur, old->pid))
+            continue;
+
+        /* Gone, or another process reused the pid */
+        if (task_start_time(old->pid, old->pid, &start) < 0 || start != old->start)
+            continue;
+
+        if (walk_subtree(old->pid, cur) < 0 && errno == ENOMEM)
+            return -1;
+
+        qsort(cur->tasks, cur->count, sizeof(*cur->tasks), task_energy_cmp);
+    }
+
+    return 0;
+}
 
 int start_energy(pid_t pid)
 {
@@ -46,10 +742,242 @@ int stop_energy(pid_t pid)
 
 int consumed_energy(pid_t pid, struct energy *energy)
 {
-    char path[100];
-    FILE *f;
+    int fd, ret;
+
+    if (pid < 0 || !energy) {
+        errno = EINVAL;
+        return -1;
+    } else if (pid == 0) {
+        return eteam_read(&self_handle, energy);
+    }
+
+    fd = open_energystat(pid);
+    if (fd < 0)
+        return -1;
+
+    ret = __eteam_energystat_read(fd, energy);
+
+    close(fd);
+
+    return ret;
+}
+
+struct eteam_handle *eteam_open(pid_t pid)
+{
+    struct eteam_handle *handle;
+
+    if (pid < 0) {
+        errno = EINVAL;
+        return NULL;
+    } else if (pid == 0) {
+        if (self_handle_fd() < 0)
+            return NULL;
+
+        return &self_handle;
+    }
+
+    handle = (struct eteam_handle *)malloc(sizeof(*handle));
+    if (!handle)
+        return NULL;
+
+    handle->pid = pid;
+    handle->fd = open_energystat(pid);
+    if (handle->fd < 0) {
+        free(handle);
+        return NULL;
+    }
+
+    return handle;
+}
+
+int eteam_read(struct eteam_handle *handle, struct energy *energy)
+{
+    char buf[ETEAM_READ_BUF_SIZE];
+
+    return eteam_read_buf(handle, buf, ETEAM_READ_BUF_SIZE, energy);
+}
+
+int eteam_read_buf(struct eteam_handle *handle, char *buf, size_t size, struct energy *energy)
+{
+    int fd;
+
+    if (!handle || !buf || size == 0 || !energy) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (handle == &self_handle)
+        fd = self_handle_fd();
+    else
+        fd = handle->fd;
+
+    if (fd < 0)
+        return -1;
+
+    return __eteam_energystat_read_buf(fd, buf, size, energy);
+}
+
+int eteam_close(struct eteam_handle *handle)
+{
     int ret;
 
+    if (!handle) {
+        errno = EINVAL;
+        return -1;
+    } else if (handle == &self_handle) {
+        return 0;
+    }
+
+    ret = close(handle->fd);
+    free(handle);
+
+    return ret;
+}
+
+int start_energy_many(const pid_t *pids, size_t n, int *errors)
+{
+    size_t i;
+    int failed = 0;
+
+    if (!pids && n > 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        int err = start_energy(pids[i]) == 0 ? 0 : errno;
+
+        if (err)
+            failed++;
+        if (errors)
+            errors[i] = err;
+    }
+
+    return failed;
+}
+
+int stop_energy_many(const pid_t *pids, size_t n, int *errors)
+{
+    size_t i;
+    int failed = 0;
+
+    if (!pids && n > 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        int err = stop_energy(pids[i]) == 0 ? 0 : errno;
+
+        if (err)
+            failed++;
+        if (errors)
+            errors[i] = err;
+    }
+
+    return failed;
+}
+
+int consumed_energy_many(const pid_t *pids, size_t n, struct energy *energies, int *errors)
+{
+    size_t i;
+    int failed = 0;
+
+    if ((!pids || !energies) && n > 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_once(&atfork_once, atfork_init);
+    pthread_mutex_lock(&pid_cache_lock);
+
+    pid_cache.generation++;
+
+    if (pid_cache_reserve(n) < 0) {
+        pthread_mutex_unlock(&pid_cache_lock);
+        return -1;
+    }
+
+    /* First get the files of all processes ... */
+    for (i = 0; i < n; ++i) {
+        struct pid_cache_entry *entry;
+        int fd;
+
+        if (pids[i] < 0) {
+            pid_cache.fds[i] = -1;
+            pid_cache.res[i] = -EINVAL;
+            continue;
+        } else if (pids[i] == 0) {
+            pid_cache.fds[i] = self_handle_fd();
+            if (pid_cache.fds[i] < 0)
+                pid_cache.res[i] = -errno;
+            continue;
+        }
+
+        entry = pid_cache_find(pids[i]);
+        if (entry) {
+            entry->used = pid_cache.generation;
+            pid_cache.fds[i] = entry->fd;
+            continue;
+        }
+
+        fd = open_energystat(pids[i]);
+        if (fd < 0) {
+            pid_cache.fds[i] = -1;
+            pid_cache.res[i] = -errno;
+            continue;
+        }
+
+        /* Failing to cache the file is not an error, we only lose the benefit
+         * of the cache for the next query. The file is read right away then,
+         * since it is not owned by the cache. */
+        if (!pid_cache_insert(pids[i], fd)) {
+            pid_cache.fds[i] = -1;
+            pid_cache.res[i] = (__eteam_energystat_read(fd, &energies[i]) < 0) ? -errno : 0;
+            close(fd);
+            continue;
+        }
+
+        pid_cache.fds[i] = fd;
+    }
+
+    /* ... then read all of them in one go ... */
+    pid_cache_read_all(n);
+
+    /* ... and finally parse the results. */
+    for (i = 0; i < n; ++i) {
+        int err = 0;
+
+        if (pid_cache.fds[i] < 0) {
+            /* Already failed or read without the cache */
+            err = (int)-pid_cache.res[i];
+        } else if (pid_cache.res[i] < 0 || parse_energystat(pid_cache.bufs + i * ENERGYSTAT_BUF_SIZE,
+                    pid_cache.res[i], &energies[i]) < 0) {
+            /* The process behind a cached file might be gone and its pid
+             * reused in the meantime, so try again with a fresh file. */
+            if (pids[i] == 0 ? eteam_read(&self_handle, &energies[i]) < 0 :
+                    pid_cache_reopen(pids[i], &energies[i]) < 0)
+                err = errno;
+        }
+
+        if (err)
+            failed++;
+        if (errors)
+            errors[i] = err;
+    }
+
+    pid_cache_expire();
+
+    pthread_mutex_unlock(&pid_cache_lock);
+
+    return failed;
+}
+
+int consumed_energy_tree(pid_t pid, struct energy *energy)
+{
+    struct task_list tasks = { NULL, 0, 0 };
+    size_t i;
+
     if (pid < 0 || !energy) {
         errno = EINVAL;
         return -1;
@@ -57,18 +985,183 @@ int consumed_energy(pid_t pid, struct energy *energy)
         pid = getpid();
     }
 
-    snprintf(path, 100, "/proc/%d/energystat", pid);
+    if (walk_tree(pid, &tasks) < 0) {
+        free(tasks.tasks);
+        return -1;
+    }
 
-    f = fopen(path, "r");
-    if (!f)
+    memset(energy, 0, sizeof(*energy));
+    for (i = 0; i < tasks.count; ++i)
+        energy_add(energy, &tasks.tasks[i].energy);
+
+    free(tasks.tasks);
+
+    return 0;
+}
+
+struct eteam_tree *eteam_tree_open(pid_t pid)
+{
+    struct eteam_tree *tree;
+
+    if (pid < 0) {
+        errno = EINVAL;
+        return NULL;
+    } else if (pid == 0) {
+        pid = getpid();
+    }
+
+    tree = (struct eteam_tree *)calloc(1, sizeof(*tree));
+    if (!tree)
+        return NULL;
+
+    tree->pid = pid;
+
+    if (walk_tree(pid, &tree->last) < 0) {
+        eteam_tree_close(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+int eteam_tree_read(struct eteam_tree *tree, struct energy *energy)
+{
+    struct task_list cur = { NULL, 0, 0 };
+    size_t i, j;
+
+    if (!tree || !energy) {
+        errno = EINVAL;
         return -1;
+    }
 
-    ret = 0;
-    if (fscanf(f, "%llu %llu %llu %llu", &energy->package, &energy->dram,
-                &energy->core, &energy->gpu) != 4)
-        ret = -1;
+    if (walk_tree(tree->pid, &cur) < 0) {
+        /* The root is gone, its descendants may still be alive. */
+        if (errno != ENOENT && errno != ESRCH) {
+            free(cur.tasks);
+            return -1;
+        }
+    }
 
-    fclose(f);
+    if (walk_orphans(&tree->last, &cur) < 0) {
+        free(cur.tasks);
+        return -1;
+    }
+
+    /* Both lists are sorted by tid. All tasks that we saw last time but which
+     * are gone now have exited -- keep their last energy values. A task with
+     * another start time is a new one which reused the tid. */
+    for (i = 0, j = 0; i < tree->last.count; ++i) {
+        const struct task_energy *old = &tree->last.tasks[i];
+
+        while (j < cur.count && cur.tasks[j].tid < old->tid)
+            j++;
+
+        if (j == cur.count || cur.tasks[j].tid != old->tid ||
+                cur.tasks[j].start != old->start)
+            energy_add(&tree->exited, &old->energy);
+    }
+
+    *energy = tree->exited;
+    for (j = 0; j < cur.count; ++j)
+        energy_add(energy, &cur.tasks[j].energy);
+
+    free(tree->last.tasks);
+    tree->last = cur;
+
+    return 0;
+}
+
+int eteam_tree_pids(struct eteam_tree *tree, pid_t *pids, size_t n)
+{
+    size_t i, count = 0;
+
+    if (!tree || (!pids && n > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i = 0; i < tree->last.count; ++i) {
+        const struct task_energy *task = &tree->last.tasks[i];
+
+        if (task->tid != task->pid)
+            continue;
+
+        if (count < n)
+            pids[count] = task->pid;
+        count++;
+    }
+
+    return (int)count;
+}
+
+int eteam_tree_close(struct eteam_tree *tree)
+{
+    if (!tree) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    free(tree->last.tasks);
+    free(tree);
+
+    return 0;
+}
+
+int consumed_energy_thread(pid_t pid, pid_t tid, struct energy *energy)
+{
+    int fd, ret;
+
+    if (pid < 0 || tid < 0 || !energy) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (pid == 0)
+        pid = getpid();
+    if (tid == 0)
+        tid = (pid_t)syscall(SYS_gettid);
+
+    fd = __eteam_energystat_open_task(pid, tid);
+    if (fd < 0)
+        return -1;
+
+    ret = __eteam_energystat_read(fd, energy);
+
+    close(fd);
 
     return ret;
 }
+
+int eteam_threads(pid_t pid, pid_t *tids, size_t n)
+{
+    char path[100];
+    struct dirent *de;
+    DIR *dir;
+    size_t count = 0;
+
+    if (pid < 0 || (!tids && n > 0)) {
+        errno = EINVAL;
+        return -1;
+    } else if (pid == 0) {
+        pid = getpid();
+    }
+
+    snprintf(path, 100, "/proc/%d/task", pid);
+
+    dir = opendir(path);
+    if (!dir)
+        return -1;
+
+    while ((de = readdir(dir))) {
+        if (de->d_name[0] < '0' || de->d_name[0] > '9')
+            continue;
+
+        if (count < n)
+            tids[count] = (pid_t)strtol(de->d_name, NULL, 10);
+        count++;
+    }
+
+    closedir(dir);
+
+    return (int)count;
+}
@@ -0,0 +1,105 @@
+#include "event_loop.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+
+EventLoop::EventLoop() :
+    _efd{-1}, _sfd{-1}, _next_id{0}, _watches{}, _ids{}, _events(64)
+{
+    _efd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (_efd < 0)
+        throw std::runtime_error{"Failed to initialize epoll FD!"};
+}
+
+EventLoop::~EventLoop()
+{
+    if (_sfd >= 0)
+        close(_sfd);
+
+    close(_efd);
+}
+
+void EventLoop::watch(int fd, const Handler &handler, uint32_t events)
+{
+    uint64_t id = _next_id++;
+
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = id;
+
+    if (epoll_ctl(_efd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        throw std::runtime_error{"Failed to watch file descriptor!"};
+
+    _watches.emplace(id, Watch{fd, handler});
+    _ids[fd] = id;
+}
+
+void EventLoop::unwatch(int fd)
+{
+    auto it = _ids.find(fd);
+
+    if (it == _ids.end())
+        return;
+
+    epoll_ctl(_efd, EPOLL_CTL_DEL, fd, nullptr);
+
+    _watches.erase(it->second);
+    _ids.erase(it);
+}
+
+void EventLoop::watch_signals(const std::vector<int> &sigs, const std::function<void(int)> &handler)
+{
+    if (_sfd >= 0)
+        throw std::runtime_error{"Signals are already watched!"};
+
+    sigset_t signals;
+
+    sigemptyset(&signals);
+    for (auto sig : sigs)
+        sigaddset(&signals, sig);
+
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+
+    _sfd = signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK);
+
+    if (_sfd < 0)
+        throw std::runtime_error{"Failed to initialize signal FD!"};
+
+    int sfd = _sfd;
+
+    watch(sfd, [sfd, handler](uint32_t) {
+        signalfd_siginfo si;
+
+        while (read(sfd, &si, sizeof(si)) == sizeof(si))
+            handler(si.ssi_signo);
+    });
+}
+
+int EventLoop::dispatch(int timeout)
+{
+    int n = epoll_wait(_efd, _events.data(), _events.size(), timeout);
+
+    if (n <= 0)
+        return 0;
+
+    for (int i = 0; i < n; ++i) {
+        auto it = _watches.find(_events[i].data.u64);
+
+        /* Unregistered by a previous handler */
+        if (it == _watches.end())
+            continue;
+
+        /* The handler may unregister itself */
+        auto handler = it->second.handler;
+        handler(_events[i].events);
+    }
+
+    return n;
+}
@@ -0,0 +1,61 @@
+#ifndef __EVENT_LOOP_H__
+#define __EVENT_LOOP_H__
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+
+
+/**
+ * A small epoll based event loop. Any pollable file descriptor (signalfds,
+ * timerfds, pidfds, pipes, ...) is registered together with a handler, which
+ * is called with the ready events whenever the descriptor becomes ready.
+ * Handlers may register and unregister descriptors themselves, events of
+ * descriptors that were unregistered in the meantime are dropped.
+ **/
+class EventLoop
+{
+   public:
+    using Handler = std::function<void(uint32_t)>;
+
+   private:
+    struct Watch
+    {
+        int fd;
+        Handler handler;
+    };
+
+    int _efd;
+    int _sfd;
+
+    /* Every registration gets a new id, so that events of a closed and
+     * reused file descriptor never reach the new handler. */
+    uint64_t _next_id;
+    std::unordered_map<uint64_t, Watch> _watches;
+    std::unordered_map<int, uint64_t> _ids;
+
+    std::vector<epoll_event> _events;
+
+   public:
+    EventLoop();
+    EventLoop(const EventLoop&) = delete;
+
+    ~EventLoop();
+
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /* Call the handler when the fd is ready (only once with EPOLLONESHOT) */
+    void watch(int fd, const Handler &handler, uint32_t events=EPOLLIN);
+    void unwatch(int fd);
+
+    /* Block the given signals and call the handler for every delivered one */
+    void watch_signals(const std::vector<int> &sigs, const std::function<void(int)> &handler);
+
+    /* Wait up to timeout ms for events and handle them, returns their number */
+    int dispatch(int timeout=-1);
+};
+
+#endif /* __EVENT_LOOP_H__ */
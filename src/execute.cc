@@ -1,17 +1,70 @@
 #include "execute.h"
 
-#include <cstring>
+#include <cerrno>
+#include <exception>
 #include <functional>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 
 namespace detail {
 
+namespace {
+
+/* Enough for execvp, which builds the paths to try on the stack */
+constexpr size_t held_stack_size = 256 * 1024;
+
+/* What a held child needs, prepared by the parent */
+struct HeldChild
+{
+    char *const *argv;
+    const char *redirect;       /* nullptr without a redirect */
+    int hold[2];                /* closed by the parent to release the child */
+    int exec[2];                /* closed by the exec (or the exit) of the child */
+};
+
+/* The held child shares the memory of the parent until it executes the
+ * program, hence it must not do more than these plain system calls. */
+int run_held(void *arg)
+{
+    auto child = static_cast<const HeldChild*>(arg);
+    char c;
+
+    ::close(child->hold[1]);
+    ::close(child->exec[0]);
+
+    /* Returns as soon as the parent closed its end */
+    while (::read(child->hold[0], &c, 1) < 0 && errno == EINTR);
+
+    if (child->redirect) {
+        int redir = ::open(child->redirect, O_WRONLY | O_APPEND | O_CREAT, 0644);
+        ::dup2(redir, 1);
+        ::dup2(redir, 2);
+        ::close(redir);
+    }
+
+    /* Don't inherit the signals blocked by the watcher */
+    sigset_t mask;
+    sigemptyset(&mask);
+    ::sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+    ::execvp(child->argv[0], child->argv);
+    ::_exit(127);
+}
+
+} /* namespace */
+
 ExecExecuter::ExecExecuter(int argc, char *argv[], int start_arg)
-    : _argv{nullptr}, _argc{0}
+    : _args{nullptr}
 {
     int end_arg = start_arg;
 
@@ -31,58 +84,28 @@ ExecExecuter::ExecExecuter(int argc, char *argv[], int start_arg)
         throw std::runtime_error{"Missing definition of a program"};
     }
 
-    _argc = end_arg - start_arg;
-    _argv = new char*[_argc + 1]; /* We need one additional space in the array,
-                                     because we have to add NULL at the end. */
+    auto args = std::make_shared<Arguments>();
 
-    for (int i = start_arg, j = 0; i < end_arg; ++i, ++j) {
-        int len = std::strlen(argv[i]);
+    args->args.assign(argv + start_arg, argv + end_arg);
 
-        _argv[j] = new char[len + 1];
-        std::strcpy(_argv[j], argv[i]);
-    }
+    /* The strings are not modified anymore, so the pointers stay valid */
+    for (auto &arg : args->args)
+        args->argv.push_back(&arg[0]);
 
     /* Terminate the argument vector */
-    _argv[_argc] = nullptr;
-}
+    args->argv.push_back(nullptr);
 
-ExecExecuter::ExecExecuter(const ExecExecuter& other) :
-    _argv{nullptr}, _argc{other._argc}
-{
-    _argv = new char*[_argc + 1];
-
-    for (int i = 0; i < _argc; ++i) {
-        int len = std::strlen(other._argv[i]);
-
-        _argv[i] = new char[len + 1];
-        std::strcpy(_argv[i], other._argv[i]);
-    }
-
-    /* Terminate the argument vector */
-    _argv[_argc] = nullptr;
-}
-
-ExecExecuter::~ExecExecuter()
-{
-    if (!_argv)
-        return;
-
-    for (char** arg = _argv; *arg != nullptr; ++arg) {
-        delete[] *arg;
-    }
-
-    delete[] _argv;
-    _argv = nullptr;
+    _args = args;
 }
 
 std::string ExecExecuter::repr() const
 {
-    return std::string{_argv[0]};
+    return _args->args[0];
 }
 
 int ExecExecuter::run()
 {
-    if (::execvp(_argv[0], _argv) == -1)
+    if (::execvp(_args->argv[0], _args->argv.data()) == -1)
         throw std::runtime_error{"Failed to execute 'execvp'"};
 
     /* If we get to this point, we are screwed anyways */
@@ -94,6 +117,106 @@ Executer* ExecExecuter::clone() const
     return new ExecExecuter(*this);
 }
 
+pid_t ExecExecuter::spawn(const std::string &redirect) const
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    if (!redirect.empty()) {
+        posix_spawn_file_actions_addopen(&actions, 1, redirect.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        posix_spawn_file_actions_adddup2(&actions, 1, 2);
+    }
+
+    /* The watcher blocks signals to receive them via a signalfd, but the
+     * program must not inherit that */
+    sigset_t mask;
+    sigemptyset(&mask);
+
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+    /* The C library uses a vfork-like clone, so the address space is not
+     * copied. Since glibc 2.24 a failed exec is reported here as well (and
+     * the child is reaped already). */
+    pid_t pid;
+    int err = ::posix_spawnp(&pid, _args->argv[0], &actions, &attr, _args->argv.data(), environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+
+    return pid;
+}
+
+pid_t ExecExecuter::spawn(const std::string &redirect, const std::function<void(pid_t)> &before_exec) const
+{
+    HeldChild child{_args->argv.data(), redirect.empty() ? nullptr : redirect.c_str(),
+        {-1, -1}, {-1, -1}};
+
+    if (::pipe2(child.hold, O_CLOEXEC) < 0)
+        return -1;
+
+    if (::pipe2(child.exec, O_CLOEXEC) < 0) {
+        ::close(child.hold[0]);
+        ::close(child.hold[1]);
+        return -1;
+    }
+
+    void *stack = ::mmap(nullptr, held_stack_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+    /* Like the vfork of posix_spawn, the clone does not copy our address
+     * space. But other than with a vfork, we keep running while the child
+     * waits for us. */
+    pid_t pid = -1;
+
+    if (stack != MAP_FAILED)
+        pid = ::clone(run_held, static_cast<char*>(stack) + held_stack_size, CLONE_VM | SIGCHLD, &child);
+
+    int err = errno;
+
+    ::close(child.hold[0]);
+    ::close(child.exec[1]);
+
+    std::exception_ptr error;
+
+    if (pid > 0) {
+        try {
+            before_exec(pid);
+        } catch (...) {
+            error = std::current_exception();
+            ::kill(pid, SIGKILL);
+        }
+    }
+
+    /* Release the child and wait until it does not use our memory anymore */
+    ::close(child.hold[1]);
+
+    char c;
+    while (pid > 0 && ::read(child.exec[0], &c, 1) < 0 && errno == EINTR);
+    ::close(child.exec[0]);
+
+    if (stack != MAP_FAILED)
+        ::munmap(stack, held_stack_size);
+
+    if (error) {
+        while (::waitpid(pid, nullptr, 0) < 0 && errno == EINTR);
+        std::rethrow_exception(error);
+    }
+
+    if (pid < 0)
+        errno = err;
+
+    return pid;
+}
+
 
 FunctionExecuter::FunctionExecuter(const std::function<int(void)> &func) : 
     _func{func}
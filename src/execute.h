@@ -1,8 +1,13 @@
 #ifndef __EXECUTE_H__
 #define __EXECUTE_H__
 
+#include <cerrno>
 #include <functional>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include <unistd.h>
 
 class Executer
 {
@@ -12,6 +17,27 @@ class Executer
     virtual std::string repr() const = 0;
     virtual int run() = 0;
     virtual Executer* clone() const = 0;
+
+    /**
+     * Start a new process without forking. Returns -1 and sets errno if that
+     * failed, ENOSYS if the executer can't spawn at all.
+     **/
+    virtual pid_t spawn(const std::string &) const
+    {
+        errno = ENOSYS;
+        return -1;
+    }
+
+    /**
+     * Like spawn(), but the new process only executes the program after
+     * before_exec was called with its pid (e.g. to open perf events which are
+     * enabled on exec). A program that can't be executed exits with 127.
+     **/
+    virtual pid_t spawn(const std::string &, const std::function<void(pid_t)> &) const
+    {
+        errno = ENOSYS;
+        return -1;
+    }
 };
 
 namespace detail {
@@ -19,18 +45,29 @@ namespace detail {
 class ExecExecuter : public Executer
 {
    private:
-    char** _argv;
-    int _argc;
+    /* The argument vector is prepared once and shared by all clones */
+    struct Arguments
+    {
+        std::vector<std::string> args;
+        std::vector<char*> argv;
+    };
+
+    std::shared_ptr<const Arguments> _args;
 
-    ExecExecuter(const ExecExecuter& other);
+    ExecExecuter(const ExecExecuter& other) = default;
 
    public:
     ExecExecuter(int argc, char *argv[], int start_arg=1);
-    ~ExecExecuter();
 
     std::string repr() const;
     int run();
     Executer* clone() const;
+
+    /* posix_spawn the program with its output redirected to the given file */
+    pid_t spawn(const std::string &redirect) const;
+
+    /* The same with a clone that shares our memory until the exec */
+    pid_t spawn(const std::string &redirect, const std::function<void(pid_t)> &before_exec) const;
 };
 
 class FunctionExecuter : public Executer
@@ -1,22 +1,35 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <stdexcept>
 #include <tuple>
 #include <vector>
 
+#include <eteam.h>
+
 #include <getopt.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <unistd.h>
 
-#include <sys/signalfd.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
+#include "event_loop.h"
 #include "program.h"
 #include "process.h"
+#include "procfs.h"
+#include "publish.h"
+#include "sampler.h"
+#include "threads.h"
 
 
 class Config
@@ -104,6 +117,9 @@ class Config
         OPT_SAMPLING,
         OPT_PATTERN,
         OPT_INFO,
+        OPT_THREADS,
+        OPT_PUBLISH,
+        OPT_COUNTERS,
     };
 
     static const char *short_opts;
@@ -122,15 +138,18 @@ class Config
     bool auto_terminate = false;
     bool sync_start = false;
     std::string redirect = {"/dev/null"};
-    std::tuple<double,int> sampling = {1.0, 10};
+    std::tuple<double, std::chrono::milliseconds> sampling = {1.0, std::chrono::seconds{10}};
     bool energy_pattern = false;
     Output info = ENERGY;
+    int threads = 0;
+    int publish = 0;
+    int counters = 0;   /* 0 = none, 1 = core, 2 = core and uncore */
 
    public:
     static Config parse(int argc, char *argv[]);
 
     double sampling_rate() const;
-    int sampling_interval() const;
+    std::chrono::milliseconds sampling_interval() const;
     std::string info_string() const;
 };
 
@@ -145,6 +164,9 @@ struct option Config::long_opts[] = {
     {"sampling",    required_argument,  nullptr,    OPT_SAMPLING},
     {"pattern",     no_argument,        nullptr,    OPT_PATTERN},
     {"info",        required_argument,  nullptr,    OPT_INFO},
+    {"threads",     optional_argument,  nullptr,    OPT_THREADS},
+    {"publish",     optional_argument,  nullptr,    OPT_PUBLISH},
+    {"counters",    optional_argument,  nullptr,    OPT_COUNTERS},
     {nullptr,       0,                  nullptr,    0}
 };
 
@@ -183,7 +205,7 @@ Config Config::parse(int argc, char *argv[])
 
                     std::string rate_val, length_val;
                     double rate;
-                    int length;
+                    std::chrono::milliseconds length;
 
                     auto pos = val.find(':');
                     if (pos == std::string::npos) {
@@ -194,11 +216,26 @@ Config Config::parse(int argc, char *argv[])
                     }
 
                     rate = rate_val.empty() ? 1.0 : std::stod(rate_val);
-                    length = length_val.empty() ? 10 : std::stoi(length_val);
+
+                    /* The interval is given in seconds or with an 'ms' suffix in milliseconds */
+                    if (length_val.empty()) {
+                        length = std::chrono::seconds{10};
+                    } else {
+                        size_t end;
+                        long val = std::stol(length_val, &end);
+                        std::string unit = length_val.substr(end);
+
+                        if (unit == "ms")
+                            length = std::chrono::milliseconds{val};
+                        else if (unit.empty() || unit == "s")
+                            length = std::chrono::seconds{val};
+                        else
+                            throw InvalidArgument{"--sampling (length)", optarg};
+                    }
 
                     if (rate < 0.1 || rate > 1.0)
                         throw InvalidArgument{"--sampling (rate)", optarg};
-                    if (length < 10)
+                    if (length < std::chrono::milliseconds{10})
                         throw InvalidArgument{"--sampling (length)", optarg};
 
                     c.sampling = std::make_tuple(rate, length);
@@ -227,6 +264,47 @@ Config Config::parse(int argc, char *argv[])
 
                 break;
             }
+            case OPT_THREADS:
+                if (!optarg) {
+                    c.threads = 10;
+                    break;
+                }
+
+                try {
+                    c.threads = std::stoi(optarg);
+                } catch (...) {
+                    throw InvalidArgument{"--threads", optarg};
+                }
+
+                if (c.threads < 1)
+                    throw InvalidArgument{"--threads", optarg};
+
+                break;
+            case OPT_PUBLISH:
+                if (!optarg) {
+                    c.publish = 100;
+                    break;
+                }
+
+                try {
+                    c.publish = std::stoi(optarg);
+                } catch (...) {
+                    throw InvalidArgument{"--publish", optarg};
+                }
+
+                if (c.publish < 1)
+                    throw InvalidArgument{"--publish", optarg};
+
+                break;
+            case OPT_COUNTERS:
+                if (!optarg)
+                    c.counters = 1;
+                else if (std::string{optarg} == "uncore")
+                    c.counters = 2;
+                else
+                    throw InvalidArgument{"--counters", optarg};
+
+                break;
             case ':':
                 throw MissingArgument(argv[optopt]);
             case '?':
@@ -244,7 +322,7 @@ double Config::sampling_rate() const
     return std::get<0>(sampling);
 }
 
-int Config::sampling_interval() const
+std::chrono::milliseconds Config::sampling_interval() const
 {
     return std::get<1>(sampling);
 }
@@ -269,16 +347,61 @@ std::string Config::info_string() const
 
 
 class ProcessHandle {
+   public:
+    /* READY -> RUNNING -> EXITED -> READY -> ... -> DONE once all runs are done */
+    enum State {
+        READY,
+        RUNNING,
+        EXITED,
+        DONE
+    };
+
    private:
     Program _prog;
+    State _state;
     ProcessPtr _cur;
+    ProcessSnapshot _last;
 
     int _runs;
-    std::vector<std::tuple<Energy, Time, double>> _stats;
+    std::vector<std::tuple<Energy, Time, double, std::vector<Energy>, CounterValues,
+        std::vector<std::pair<std::string, Energy>>, Estimate>> _stats;
+    int _counters;
+
+    int _thread_top;
+    std::unique_ptr<ThreadTracker> _threads;
+    std::vector<std::vector<ThreadStats>> _thread_stats;
+
+    /* Only measure a fraction of the runtime if sampling is enabled */
+    std::unique_ptr<Sampler> _sampler;
 
    public:
-    ProcessHandle(const Program& prog);
+    ProcessHandle(const Program& prog, int thread_top=0, int counters=0, double sampling_rate=1.0,
+            std::chrono::milliseconds sampling_interval=std::chrono::milliseconds{0});
+
+    bool update();
+    void sample_threads();
+
+    /* The perf fds that report new and exited threads and their handler */
+    std::vector<int> thread_fds() const;
+    void track_threads();
 
+    /* Take a new snapshot and switch to EXITED if the running process finished */
+    bool check_exited();
+
+    /* The timerfd of the sampling windows (-1 without sampling) and its handler */
+    int sampling_fd() const;
+    void sample_energy();
+
+    /* Whether the whole process tree is measured, whose measurement has to be
+     * polled regularly (see Measure::poll()) */
+    bool tree() const;
+    void poll();
+
+    /* The pid and the pidfd of the current run (-1 if there is none) */
+    pid_t pid() const;
+    int pidfd() const;
+
+    State state() const;
     bool running() const;
     bool finished() const;
 
@@ -289,20 +412,100 @@ class ProcessHandle {
     std::string name() const;
     std::string type() const;
     void display_stats() const;
+    void display_thread_stats() const;
 };
 
-ProcessHandle::ProcessHandle(const Program& prog) :
-    _prog{prog}, _cur{nullptr}, _runs{0}, _stats{}
-{}
+ProcessHandle::ProcessHandle(const Program& prog, int thread_top, int counters, double sampling_rate,
+        std::chrono::milliseconds sampling_interval) :
+    _prog{prog}, _state{READY}, _cur{nullptr}, _last{}, _runs{0}, _stats{}, _counters{counters},
+    _thread_top{thread_top}, _threads{}, _thread_stats{}, _sampler{}
+{
+    if (sampling_rate < 1.0)
+        _sampler.reset(new Sampler{sampling_rate, sampling_interval});
+}
+
+bool ProcessHandle::update()
+{
+    if (_cur) {
+        _last = _cur->snapshot();
+        sample_threads();
+    }
+
+    return finished();
+}
+
+bool ProcessHandle::check_exited()
+{
+    if (_state != RUNNING || !update())
+        return false;
+
+    _state = EXITED;
+    return true;
+}
+
+void ProcessHandle::sample_threads()
+{
+    if (_threads)
+        _threads->update();
+}
+
+std::vector<int> ProcessHandle::thread_fds() const
+{
+    return _threads ? _threads->fds() : std::vector<int>{};
+}
+
+void ProcessHandle::track_threads()
+{
+    if (_threads)
+        _threads->events();
+}
+
+int ProcessHandle::sampling_fd() const
+{
+    return _sampler ? _sampler->fd() : -1;
+}
+
+void ProcessHandle::sample_energy()
+{
+    if (_sampler)
+        _sampler->step();
+}
+
+bool ProcessHandle::tree() const
+{
+    return _prog.aggregation() == TREE;
+}
+
+void ProcessHandle::poll()
+{
+    if (_state == RUNNING)
+        _cur->measure()->poll();
+}
+
+pid_t ProcessHandle::pid() const
+{
+    return _cur ? _cur->pid() : -1;
+}
+
+int ProcessHandle::pidfd() const
+{
+    return _cur ? _cur->pidfd() : -1;
+}
+
+ProcessHandle::State ProcessHandle::state() const
+{
+    return _state;
+}
 
 bool ProcessHandle::running() const
 {
-    return _cur && _cur->running();
+    return _state == RUNNING;
 }
 
 bool ProcessHandle::finished() const
 {
-    return !_cur || _cur->finished();
+    /* Use the state from the last snapshot -- see update() */
+    return !_cur || _last.finished();
 }
 
 bool ProcessHandle::start(int max_runs)
@@ -310,11 +513,24 @@ bool ProcessHandle::start(int max_runs)
     if (running())
         return true;
 
-    if (_runs >= max_runs)
+    if (_runs >= max_runs) {
+        _state = DONE;
         return false;
+    }
+
+    /* Follow the threads from the very beginning */
+    if (_thread_top > 0)
+        _cur = _prog.run([this](pid_t pid) { _threads.reset(new ThreadTracker{pid}); });
+    else
+        _cur = _prog.run();
 
-    _cur = _prog.run();
     _runs++;
+    _state = RUNNING;
+
+    if (_sampler)
+        _sampler->start(_cur);
+
+    update();
     return true;
 }
 
@@ -323,7 +539,8 @@ void ProcessHandle::term()
     if (!_cur)
         return;
 
-    if (_cur->running())
+    /* Sleeping processes have to be terminated as well */
+    if (!_cur->finished())
         _cur->term();
 
     cleanup();
@@ -334,12 +551,33 @@ void ProcessHandle::cleanup()
     if (!_cur)
         return;
 
+    /* The counters of a finished process do not change anymore, hence the last
+     * snapshot can be used as is. Otherwise get a new one. */
+    if (!finished())
+        update();
+
+    if (_sampler)
+        _sampler->stop();
+
     /* Get the statistics and clean up the zombie */
-    _stats.emplace_back(std::make_tuple(_cur->energy(), _cur->time(), _cur->rate()));
+    auto measure = _cur->measure();
+    _stats.emplace_back(std::make_tuple(measure->energy(_last), _last.time, measure->rate(_last),
+                measure->packages(_last), measure->counters(), measure->compared(_last),
+                _sampler ? measure->estimate(_last) : Estimate{}));
+
+    if (_threads) {
+        /* Threads that exited since the last update */
+        _threads->events();
+
+        _thread_stats.emplace_back(_threads->top(_thread_top));
+        _threads.reset();
+    }
+
     _cur->wait();
 
     /* Clear the pointer to the process */
     _cur.reset();
+    _state = READY;
 }
 
 std::string ProcessHandle::name() const
@@ -354,7 +592,28 @@ std::string ProcessHandle::type() const
 
 void ProcessHandle::display_stats() const
 {
-    std::cout << "pkg,core,dram,gpu,user,system,looped,exec,wall,loops,rate" << std::endl;
+    /* Measurements which distinguish CPU packages get additional columns */
+    size_t pkgs = _stats.empty() ? 0 : std::get<3>(_stats.front()).size();
+
+    std::cout << "pkg,core,dram,gpu,user,system,looped,exec,wall,loops,rate";
+    for (size_t i = 0; i < pkgs; ++i)
+        std::cout << ",pkg" << i << ",core" << i << ",dram" << i;
+    if (!_stats.empty()) {
+        /* The divergence is the difference of the package energy to the primary measurement in % */
+        for (auto &c : std::get<5>(_stats.front())) {
+            std::cout << "," << c.first << "_pkg," << c.first << "_core," << c.first << "_dram,"
+                << c.first << "_gpu," << c.first << "_div";
+        }
+    }
+    if (_counters > 0)
+        std::cout << ",instructions,cycles,cache_misses,branch_misses,ipc,nj_per_instr,nj_per_miss";
+    if (_counters > 1)
+        std::cout << ",mem_read,mem_write";
+    if (_sampler) {
+        /* The energy extrapolated from the sampled windows and the 95% confidence interval */
+        std::cout << ",est_pkg,est_pkg_err,est_core,est_core_err,est_dram,est_dram_err,est_gpu,est_gpu_err,windows";
+    }
+    std::cout << std::endl;
 
     for (auto &stat : _stats) {
         Energy e = std::get<0>(stat);
@@ -364,7 +623,55 @@ void ProcessHandle::display_stats() const
         std::cout << e.package << "," << e.core << "," << e.dram << "," << e.gpu << ","
             << t.user << "," << t.system << "," << t.looped << ","
             << t.user + t.system - t.looped << "," << t.wall << ","
-            << e.loops << "," << rate*100 << std::endl;
+            << e.loops << "," << rate*100;
+
+        for (auto &p : std::get<3>(stat))
+            std::cout << "," << p.package << "," << p.core << "," << p.dram;
+
+        for (auto &c : std::get<5>(stat)) {
+            Energy o = c.second;
+            double div = e.package > 0 ? (static_cast<double>(o.package) - e.package) / e.package * 100 : 0.0;
+
+            std::cout << "," << o.package << "," << o.core << "," << o.dram << "," << o.gpu << "," << div;
+        }
+
+        if (_counters > 0) {
+            auto &c = std::get<4>(stat);
+
+            /* Package energy is in uJ */
+            auto ratio = [](double a, unsigned long long b) { return b > 0 ? a / b : 0.0; };
+
+            std::cout << "," << c.instructions << "," << c.cycles << "," << c.cache_misses << ","
+                << c.branch_misses << "," << ratio(c.instructions, c.cycles) << ","
+                << ratio(e.package * 1000.0, c.instructions) << ","
+                << ratio(e.package * 1000.0, c.cache_misses);
+        }
+
+        if (_counters > 1)
+            std::cout << "," << std::get<4>(stat).mem_read << "," << std::get<4>(stat).mem_write;
+
+        if (_sampler) {
+            auto &est = std::get<6>(stat);
+
+            for (auto &i : {est.package, est.core, est.dram, est.gpu})
+                std::cout << "," << i.value << "," << i.error;
+
+            std::cout << "," << est.windows;
+        }
+
+        std::cout << std::endl;
+    }
+}
+
+void ProcessHandle::display_thread_stats() const
+{
+    std::cout << "run,tid,name,pkg,core,dram,gpu" << std::endl;
+
+    for (size_t run = 0; run < _thread_stats.size(); ++run) {
+        for (auto &t : _thread_stats[run]) {
+            std::cout << run << "," << t.tid << "," << t.name << "," << t.energy.package << ","
+                << t.energy.core << "," << t.energy.dram << "," << t.energy.gpu << std::endl;
+        }
     }
 }
 
@@ -372,183 +679,302 @@ void ProcessHandle::display_stats() const
 class ProcessWatcher
 {
    private:
+    EventLoop _loop;
     std::vector<ProcessHandle> _processes;
-    int _sfd;
 
     int _runs;
     bool _automatic_terminate;
     bool _synced_start;
+    bool _threads;
+
+    /* Number of processes in the RUNNING state */
+    size_t _running;
+    bool _done;
+
+    /* The timerfd to poll the measurements of process trees (-1 if there are none) */
+    int _tree_fd;
 
    private:
-    void prepare_signal_fd(const std::vector<unsigned int> &sigs = {SIGCHLD});
-    void close_signal_fd();
-    int wait_for_signal();
+    /* Interval in which the threads of all processes are sampled */
+    static constexpr std::chrono::milliseconds thread_interval{100};
+
+    /* Interval in which the measurements of process trees are polled */
+    static constexpr std::chrono::milliseconds tree_interval{10};
+
+    void handle_signal(int sig);
+    void handle_exit(size_t i);
+    void finish(size_t i);
 
-    bool start_processes();
-    bool restart_processes();
+    /* Stop watching the fds of the current run of a process */
+    void unwatch(ProcessHandle &ph);
+
+    bool start_process(size_t i);
+    void restart_process(size_t i);
     void term_processes();
 
+    /* Read the process trees and reap the descendants that were reparented to
+     * us and exited since */
+    void poll_trees();
+    void reap_orphans();
+
    public:
     ProcessWatcher(const std::vector<Program> &progs, const Config &conf);
     ProcessWatcher(const ProcessWatcher&) = delete;
-    ProcessWatcher(ProcessWatcher &&o);
 
     ~ProcessWatcher();
 
     ProcessWatcher& operator=(const ProcessWatcher&) = delete;
-    ProcessWatcher& operator=(ProcessWatcher &&o);
 
     void loop();
 
     void display_process_stats();
+    void display_thread_stats();
     void display_sampling_stats();
 };
 
-void ProcessWatcher::prepare_signal_fd(const std::vector<unsigned int> &sigs)
+void ProcessWatcher::handle_signal(int sig)
 {
-    sigset_t signals;
+    switch (sig) {
+        case SIGCHLD:
+            /* Read the trees before an orphan that just exited is reaped */
+            if (_tree_fd >= 0)
+                poll_trees();
+
+            /* Only processes without a pidfd have to be checked for their exit */
+            for (size_t i = 0; i < _processes.size(); ++i) {
+                auto &ph = _processes[i];
+
+                if (ph.pidfd() < 0 && ph.check_exited())
+                    finish(i);
+            }
+            break;
+        case SIGINT:
+            term_processes();
+            _done = true;
+            break;
+        default:
+            std::cout << "Catched unknown signal" << std::endl;
+            _done = true;
+    }
+}
 
-    sigemptyset(&signals);
-    for (auto sig : sigs)
-        sigaddset(&signals, sig);
+void ProcessWatcher::handle_exit(size_t i)
+{
+    auto &ph = _processes[i];
 
-    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    if (!ph.running())
+        return;
 
-    _sfd = signalfd(-1, &signals, SFD_CLOEXEC);
+    _loop.unwatch(ph.pidfd());
 
-    if (_sfd < 0)
-        throw std::runtime_error{"Failed to initialize signal FD!"};
+    /* This snapshot is used for all further decisions and the statistics. It
+     * takes the exit from the pidfd as well, so a readable pidfd is never
+     * watched again (which would wake us up right away over and over). */
+    if (!ph.check_exited()) {
+        _loop.watch(ph.pidfd(), [this, i](uint32_t) { handle_exit(i); }, EPOLLIN | EPOLLONESHOT);
+        return;
+    }
+
+    finish(i);
 }
 
-void ProcessWatcher::close_signal_fd()
+void ProcessWatcher::finish(size_t i)
 {
-    if (_sfd > 0)
-        close(_sfd);
+    _running--;
+
+    /* Automatically term all other processes if the first one is done. */
+    if (_automatic_terminate) {
+        for (auto &ph : _processes) {
+            if (!ph.running())
+                continue;
+
+            unwatch(ph);
+
+            ph.term();
+            _running--;
+        }
+    }
+
+    if (!_synced_start && !_automatic_terminate) {
+        restart_process(i);
+        return;
+    }
+
+    /* Otherwise only continue when all processes finished. */
+    if (_running > 0)
+        return;
 
-    _sfd = -1;
+    for (size_t j = 0; j < _processes.size(); ++j)
+        restart_process(j);
 }
 
-int ProcessWatcher::wait_for_signal()
+bool ProcessWatcher::start_process(size_t i)
 {
-    if (_sfd < 0)
-        throw std::runtime_error{"Signal FD not properly initialized!"};
+    auto &ph = _processes[i];
+
+    if (!ph.start(_runs))
+        return false;
+
+    _running++;
 
-    signalfd_siginfo si;
-    read(_sfd, &si, sizeof(si));
+    /* Get notified once when the process exits. */
+    if (ph.pidfd() >= 0)
+        _loop.watch(ph.pidfd(), [this, i](uint32_t) { handle_exit(i); }, EPOLLIN | EPOLLONESHOT);
 
-    return si.ssi_signo;
+    /* And whenever it creates or ends a thread */
+    for (int fd : ph.thread_fds())
+        _loop.watch(fd, [this, i](uint32_t) { _processes[i].track_threads(); });
+
+    return true;
 }
 
-bool ProcessWatcher::start_processes()
+void ProcessWatcher::unwatch(ProcessHandle &ph)
 {
-    bool any_started = false;
+    if (ph.pidfd() >= 0)
+        _loop.unwatch(ph.pidfd());
 
-    for (auto &ph : _processes) {
-        any_started |= ph.start(_runs);
+    for (int fd : ph.thread_fds())
+        _loop.unwatch(fd);
+}
+
+void ProcessWatcher::restart_process(size_t i)
+{
+    auto &ph = _processes[i];
+
+    if (ph.state() == ProcessHandle::EXITED) {
+        unwatch(ph);
+        ph.cleanup();
     }
 
-    return any_started;
+    if (ph.state() == ProcessHandle::READY)
+        start_process(i);
 }
 
-bool ProcessWatcher::restart_processes()
+void ProcessWatcher::term_processes()
 {
-    /* First check if any of the processes actually finished */
-    bool any_finished = false;
     for (auto &ph : _processes) {
-        any_finished |= ph.finished();
-    }
+        if (!ph.running())
+            continue;
 
-    /* If no process finished, this SIGCHLD might already be handled by a previous
-     * invocation of this function. We have nothing to do here, bail out early. */
-    if (!any_finished)
-        return true;
+        unwatch(ph);
 
-    /* Automatically term all other processes if the first one is done. */
-    if (_automatic_terminate) {
-        for (auto &ph : _processes) {
-            ph.term();
-        }
+        ph.term();
     }
 
-    /* If synced_start is enabled -- only continue when all processes finished. */
-    if (_synced_start) {
-        bool all_finished = true;
-
-        for (auto &ph : _processes) {
-            all_finished &= ph.finished();
-        }
-
-        if (!all_finished)
-            return true;
-    }
+    _running = 0;
+}
 
-    /* Restart all processes that are already finished */
-    bool any_started = false;
+void ProcessWatcher::poll_trees()
+{
+    unsigned long long expirations;
 
-    for (auto &ph : _processes) {
-        if (ph.finished()) {
-            ph.cleanup();
+    /* Acknowledge the timer, we may also be called for a SIGCHLD */
+    if (read(_tree_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        return;
 
-            any_started |= ph.start(_runs);
-        }
-    }
+    for (auto &ph : _processes)
+        ph.poll();
 
-    return any_started;
+    reap_orphans();
 }
 
-void ProcessWatcher::term_processes()
+void ProcessWatcher::reap_orphans()
 {
-    for (auto &ph : _processes) {
-        ph.term();
+    pid_t self = getpid();
+    std::vector<pid_t> tids(16), children;
+    int count;
+
+    while ((count = eteam_threads(self, tids.data(), tids.size())) > static_cast<int>(tids.size()))
+        tids.resize(count * 2);
+
+    for (int i = 0; i < count; ++i)
+        procfs::read_task_children(self, tids[i], children);
+
+    /* Our own children are the programs, everything else was reparented */
+    for (auto pid : children) {
+        if (std::none_of(_processes.begin(), _processes.end(),
+                    [pid](const ProcessHandle &ph) { return ph.pid() == pid; }))
+            waitpid(pid, nullptr, WNOHANG);
     }
 }
 
 ProcessWatcher::ProcessWatcher(const std::vector<Program> &programs, const Config &conf) :
-    _processes{}, _sfd{-1}, _runs{conf.repeat}, _automatic_terminate{conf.auto_terminate},
-    _synced_start{conf.sync_start}
+    _loop{}, _processes{}, _runs{conf.repeat}, _automatic_terminate{conf.auto_terminate},
+    _synced_start{conf.sync_start}, _threads{conf.threads > 0}, _running{0}, _done{false},
+    _tree_fd{-1}
 {
-    prepare_signal_fd({SIGCHLD, SIGINT});
+    _loop.watch_signals({SIGCHLD, SIGINT}, [this](int sig) { handle_signal(sig); });
 
     for (auto &prog : programs) {
-        _processes.emplace_back(prog);
+        _processes.emplace_back(prog, conf.threads, conf.counters, conf.sampling_rate(),
+                conf.sampling_interval());
     }
-}
 
-ProcessWatcher::ProcessWatcher(ProcessWatcher &&o) :
-    _processes{std::move(o._processes)}, _sfd{o._sfd}, _runs{o._runs},
-    _automatic_terminate{o._automatic_terminate}, _synced_start{o._synced_start}
-{
-    o._sfd = -1;
+    for (size_t i = 0; i < _processes.size(); ++i) {
+        if (_processes[i].sampling_fd() >= 0)
+            _loop.watch(_processes[i].sampling_fd(), [this, i](uint32_t) { _processes[i].sample_energy(); });
+    }
+
+    if (std::none_of(_processes.begin(), _processes.end(), [](const ProcessHandle &ph) { return ph.tree(); }))
+        return;
+
+    /* The tasks of a tree are only seen when it is read, hence read it often.
+     * Descendants whose parent exits are reparented to us instead of init, so
+     * that they are not reaped before we read their energy one last time. */
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+
+    _tree_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (_tree_fd < 0)
+        throw std::runtime_error{"Failed to create the tree timer!"};
+
+    itimerspec its{};
+    its.it_interval.tv_nsec = std::chrono::nanoseconds{tree_interval}.count();
+    its.it_value = its.it_interval;
+
+    timerfd_settime(_tree_fd, 0, &its, nullptr);
+    _loop.watch(_tree_fd, [this](uint32_t) { poll_trees(); });
 }
 
 ProcessWatcher::~ProcessWatcher()
 {
-    close_signal_fd();
+    if (_tree_fd >= 0) {
+        _loop.unwatch(_tree_fd);
+        close(_tree_fd);
+    }
 }
 
 void ProcessWatcher::loop()
 {
-    bool done = false;
+    for (size_t i = 0; i < _processes.size(); ++i)
+        start_process(i);
 
-    if (!start_processes()) {
+    if (_running == 0) {
         std::cout << "Failed to start any processes!" << std::endl;
         return;
     }
 
-    while (!done) {
-        int sig = wait_for_signal();
+    using Clock = std::chrono::steady_clock;
 
-        switch (sig) {
-            case SIGCHLD:
-                done = !restart_processes();
-                break;
-            case SIGINT:
-                term_processes();
-                done = true;
-                break;
-            default:
-                std::cout << "Catched unknown signal" << std::endl;
-                done = true;
+    auto next_threads = Clock::now() + thread_interval;
+
+    /* Every event only touches the process that it belongs to */
+    while (!_done && _running > 0) {
+        /* Wake up regularly to sample the energy of the threads if we have to. New
+         * and exited threads are reported in between by their own events. */
+        int timeout = -1;
+
+        if (_threads) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(next_threads - Clock::now());
+            timeout = std::max(left.count(), 0L);
+        }
+
+        _loop.dispatch(timeout);
+
+        if (_threads && Clock::now() >= next_threads) {
+            for (auto &ph : _processes)
+                ph.sample_threads();
+
+            next_threads = Clock::now() + thread_interval;
         }
     }
 }
@@ -563,15 +989,49 @@ void ProcessWatcher::display_process_stats()
             ph.display_stats();
         }
     }
+
+    /* The energy that the attribution did not account to any program */
+    auto &attributor = detail::attribution::Attributor::instance();
+
+    if (attributor.used()) {
+        Energy e = attributor.other().energy();
+
+        std::cout << "= other (" << Measure::measure_name(ATTRIBUTION) << ") =" << std::endl
+            << "pkg,core,dram,gpu" << std::endl
+            << e.package << "," << e.core << "," << e.dram << "," << e.gpu << std::endl;
+    }
+}
+
+void ProcessWatcher::display_thread_stats()
+{
+    for (auto &ph : _processes) {
+        std::cout << "= " << ph.name() << " (" << ph.type() << ") threads =" << std::endl;
+        ph.display_thread_stats();
+    }
 }
 
 
 void usage(const std::string &prog, int exit_code=EXIT_FAILURE)
 {
     std::cout
-        << "Usage: " << prog << " [OPTIONS] -- [?-!] PROG [ARGS...] [-- [?-!] PROG [ARGS...]...]" << std::endl
+        << "Usage: " << prog << " [OPTIONS] -- [TYPE] [+] PROG [ARGS...] [-- [TYPE] [+] PROG [ARGS...]...]" << std::endl
+        << "       " << prog << " --publish[=MS]" << std::endl
         << "Execute the given program(s) with enabled energy accounting." << std::endl
         << std::endl
+        << "Program definition:" << std::endl
+        << " ?                  Measure with E-Team (default)" << std::endl
+        << " -                  Measure with the RAPL MSRs" << std::endl
+        << " %                  Measure with the RAPL zones of the powercap framework" << std::endl
+        << " ^                  Measure with the RAPL perf events (falls back to powercap)" << std::endl
+        << " =                  Split the energy of the system among the programs in proportion" << std::endl
+        << "                      to their CPU time (powercap or MSRs)" << std::endl
+        << " !                  Don't measure at all" << std::endl
+        << " --types=?-         Measure with several methods at once, e.g. E-Team and the MSRs, and" << std::endl
+        << "                      display the others and their divergence from the first one" << std::endl
+        << "                      (of the package energy in %, the other domains are only displayed)" << std::endl
+        << " +                  Account the energy of all threads and child processes" << std::endl
+        << "                      to the program (E-Team only)" << std::endl
+        << std::endl
         << "Options:" << std::endl
         << " -h, --help         Print this help message" << std::endl
         << " --repeat=N         Repeat the execution N times (default=1)" << std::endl
@@ -580,11 +1040,20 @@ void usage(const std::string &prog, int exit_code=EXIT_FAILURE)
         << " --redirect=FILE    Redirect output of processes to FILE (default='/dev/null')" << std::endl
         << "                      [use '' for no redirect]" << std::endl
         << " --sampling=R:L     Use *random sampling* with a rate of R (default=1.0) and" << std::endl
-        << "                      an interval of L (default=10) seconds" << std::endl
+        << "                      an interval of L (default=10) seconds [or Lms milliseconds]" << std::endl
         << " --pattern          Generate a special energy pattern before and after each" << std::endl
         << "                      benchmark run" <<std::endl
         << " --info=TYPE        Define how much information should be displayed (default=energy)" << std::endl
-        << "                      [available options are: none, info, stats, energy, full]" << std::endl;
+        << "                      [available options are: none, info, stats, energy, full]" << std::endl
+        << " --threads[=N]      Sample the energy of all threads and display the top N (default=10)" << std::endl
+        << "                      threads of each run" << std::endl
+        << " --counters[=uncore]" << std::endl
+        << "                    Count instructions, cycles, cache and branch misses of every run and" << std::endl
+        << "                      display the IPC and the energy per instruction and cache miss" << std::endl
+        << "                      [with 'uncore' also the memory traffic of the system in MiB]" << std::endl
+        << " --publish[=MS]     Don't execute any programs, but publish the energy of all processes" << std::endl
+        << "                      which query it via consumed_energy_shm() every MS (default=100)" << std::endl
+        << "                      milliseconds until SIGINT or SIGTERM" << std::endl;
 
     exit(exit_code);
 }
@@ -605,16 +1074,77 @@ class InvalidProgramDefinition
     }
 };
 
-bool parse_measure_type(const std::string &arg, MeasureType &mt)
+bool parse_measure_type(char c, MeasureType &mt)
 {
-    if (arg == "!") {
-        mt = NONE;
-        return true;
-    } else if (arg == "-") {
-        mt = MSR;
+    switch (c) {
+        case '!':
+            mt = NONE;
+            return true;
+        case '-':
+            mt = MSR;
+            return true;
+        case '?':
+            mt = ETEAM;
+            return true;
+        case '%':
+            mt = POWERCAP;
+            return true;
+        case '^':
+            mt = PERF;
+            return true;
+        case '=':
+            mt = ATTRIBUTION;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Either a single measurement type, or several ones at once with the explicit
+ * option form, e.g. '--types=?-' to measure with E-Team and the MSRs. Only
+ * the option form may combine them, so that neither a stray '--' nor a
+ * program argument like '-%' is taken for a combination. */
+bool parse_measure_types(const std::string &arg, std::vector<MeasureType> &mts)
+{
+    static const std::string option = {"--types="};
+    MeasureType mt;
+
+    if (arg.size() == 1 && parse_measure_type(arg[0], mt)) {
+        mts = {mt};
         return true;
-    } else if (arg == "?") {
-        mt = ETEAM;
+    }
+
+    if (arg.compare(0, option.size(), option) != 0)
+        return false;
+
+    std::vector<MeasureType> types;
+    std::string seen;
+
+    for (char c : arg.substr(option.size())) {
+        if (!parse_measure_type(c, mt))
+            throw InvalidProgramDefinition{"Unknown measurement type '" + std::string(1, c) + "' in '" + arg + "'."};
+
+        if (seen.find(c) != std::string::npos)
+            throw InvalidProgramDefinition{"The measurement type '" + std::string(1, c) + "' is given twice in '" + arg + "'."};
+
+        seen += c;
+        types.push_back(mt);
+    }
+
+    if (types.empty())
+        throw InvalidProgramDefinition{"No measurement type is given in '" + arg + "'."};
+
+    if (types.size() > 1 && seen.find('!') != std::string::npos)
+        throw InvalidProgramDefinition{"Not measuring at all ('!') can't be combined with other measurements in '" + arg + "'."};
+
+    mts = types;
+    return true;
+}
+
+bool parse_aggregation(const std::string &arg, Aggregation &agg)
+{
+    if (arg == "+") {
+        agg = TREE;
         return true;
     }
 
@@ -624,19 +1154,47 @@ bool parse_measure_type(const std::string &arg, MeasureType &mt)
 void parse_program_definition(int argc, char *argv[], int pos, std::vector<Program> &progs,
         const Config &conf)
 {
-    MeasureType mt = ETEAM;
+    std::vector<MeasureType> mts{ETEAM};
+    Aggregation agg = PROCESS;
+
+    /* The first arguments will define which measurement type and aggregation should be used.
+     * Both are optional and may be given in any order. */
+    bool has_mt = false, has_agg = false;
+
+    while (pos < argc) {
+        if (parse_measure_types(argv[pos], mts)) {
+            /* Check that the user not accidentally specified the measurement type twice in
+             * the program definition. */
+            if (has_mt)
+                throw InvalidProgramDefinition{"The measurement type is specified twice. Which one should I use?"};
+
+            has_mt = true;
+        } else if (parse_aggregation(argv[pos], agg)) {
+            if (has_agg)
+                throw InvalidProgramDefinition{"The aggregation is specified twice."};
+
+            has_agg = true;
+        } else {
+            break;
+        }
 
-    /* The first argument will define which measurement type should be used. */
-    if (parse_measure_type(argv[pos], mt))
         pos++;
+    }
 
-    /* Check again before parsing the program that the user not accidentally specified the
-     * measurement type twice in the program definition. */
-    if (parse_measure_type(argv[pos], mt))
-        throw InvalidProgramDefinition{"The measurement type is specified twice. Which one should I use?"};
+    if (pos == argc || std::string{argv[pos]} == "--")
+        throw InvalidProgramDefinition{"The program to execute is missing."};
 
     try {
-        progs.emplace_back(argc, argv, pos, mt, conf.redirect);
+        progs.emplace_back(argc, argv, pos, mts.front(), agg, conf.redirect);
+
+        for (size_t i = 1; i < mts.size(); ++i)
+            progs.back().compare(mts[i]);
+
+        if (conf.counters > 0)
+            progs.back().count(conf.counters > 1);
+
+        if (conf.sampling_rate() < 1.0)
+            progs.back().sample();
     } catch(...) {
         throw InvalidProgramDefinition{"Malformed program definition."};
     }
@@ -664,6 +1222,18 @@ int main(int argc, char *argv[])
         usage(argv[0]);
     }
 
+    if (conf.publish > 0) {
+        try {
+            Publisher p{conf.publish};
+            p.loop();
+        } catch (std::runtime_error &e) {
+            std::cout << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        return 0;
+    }
+
     int pos = 1;
 
     while (pos < argc) {
@@ -712,9 +1282,11 @@ int main(int argc, char *argv[])
             << " auto_terminate=" << conf.auto_terminate << std::endl
             << " sync_start=" << conf.sync_start << std::endl
             << " redirect=" << (conf.redirect.empty() ? "NONE" : conf.redirect) << std::endl
-            << " sampling=" << conf.sampling_rate() << ":" << conf.sampling_interval() << std::endl
+            << " sampling=" << conf.sampling_rate() << ":" << conf.sampling_interval().count() << "ms" << std::endl
             << " energy_pattern=" << conf.energy_pattern << std::endl
-            << " info=" << conf.info_string() << std::endl;
+            << " info=" << conf.info_string() << std::endl
+            << " threads=" << conf.threads << std::endl
+            << " counters=" << conf.counters << std::endl;
 
         std::cout << "Measured programs:" << std::endl;
         for (auto &prog : progs) {
@@ -735,6 +1307,9 @@ int main(int argc, char *argv[])
     /* Display statistics and energy consumption */
     if (conf.info & Config::ENERGY) {
         pw.display_process_stats();
+
+        if (conf.threads > 0)
+            pw.display_thread_stats();
     }
 
     return 0;
@@ -1,54 +1,103 @@
 #include "measure.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
 #include <fstream>
-#include <limits>
-#include <sstream>
+#include <iterator>
+#include <map>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <eteam.h>
 
+#include <cpuid.h>
 #include <unistd.h>
+#include <dirent.h>
 #include <fcntl.h>
+#include <sys/syscall.h>
+
+#include <linux/perf_event.h>
 
 #include "process.h"
+#include "procfs.h"
 #include "energy.h"
 #include "time.h"
+#include "topology.h"
 
 
-Measure* Measure::measure_with(MeasureType type, Process *proc)
+Measure* Measure::measure_with(MeasureType type, Process *proc, Aggregation agg)
 {
     switch (type) {
         case NONE:
             return new detail::NoMeasure{proc};
         case ETEAM:
-            return new detail::ETeamMeasure{proc};
+            return new detail::ETeamMeasure{proc, agg};
         case MSR:
             return new detail::MSRMeasure{proc};
+        case POWERCAP:
+            return new detail::PowercapMeasure{proc};
+        case ATTRIBUTION:
+            return new detail::AttributionMeasure{proc};
+        case PERF:
+            /* Use the powercap zones if the kernel has no RAPL perf PMU or
+             * we are not allowed to use it. */
+            try {
+                return new detail::PerfMeasure{proc};
+            } catch (std::runtime_error &) {
+                return new detail::PowercapMeasure{proc};
+            }
         default:
             throw std::invalid_argument{"Invalid measurement type"};
     }
 }
 
-std::string Measure::measure_name(MeasureType type)
+Measure* Measure::measure_with(const std::vector<MeasureType> &types, Process *proc, Aggregation agg)
+{
+    if (types.empty())
+        throw std::invalid_argument{"No measurement type"};
+
+    if (types.size() == 1)
+        return measure_with(types.front(), proc, agg);
+
+    return new detail::MultiMeasure{proc, agg, types};
+}
+
+std::string Measure::measure_name(MeasureType type, Aggregation agg)
 {
     switch (type) {
         case NONE:
             return detail::NoMeasure::name;
         case ETEAM:
-            return detail::ETeamMeasure::name;
+            /* Only E-Team can distinguish between single processes and trees */
+            return agg == TREE ? detail::ETeamMeasure::name + "+tree" : detail::ETeamMeasure::name;
         case MSR:
             return detail::MSRMeasure::name;
+        case POWERCAP:
+            return detail::PowercapMeasure::name;
+        case PERF:
+            return detail::PerfMeasure::name;
+        case ATTRIBUTION:
+            return detail::AttributionMeasure::name;
         default:
             throw std::invalid_argument{"Invalid measurement type"};
     }
 }
 
-void Measure::update_times()
+void Measure::update_times(const ProcessSnapshot &snap)
 {
-    if (!_proc->valid())
+    if (!snap.valid())
         return;
 
-    Time cur_proc_time = _proc->time();
+    Time cur_proc_time = snap.time;
     double delta_s = (cur_proc_time.user + cur_proc_time.system - cur_proc_time.looped) - \
                      (_last_proc_time.user + _last_proc_time.system - _last_proc_time.looped);
 
@@ -60,22 +109,46 @@ void Measure::update_times()
     _last_proc_time = cur_proc_time;
 }
 
-Measure::Measure(Process *proc) :
-    _running{false}, _proc{proc}, _last_proc_time{0},
-    _measured{0}, _not_measured{0}
+Measure::Measure(Process *proc, Aggregation agg) :
+    _running{false}, _proc{proc}, _aggregation{agg}, _last_proc_time{0},
+    _measured{0}, _not_measured{0}, _count{false}, _count_uncore{false}, _counters{},
+    _sample{false}, _windows{}, _window{}
 {}
 
+Window Measure::window(const ProcessSnapshot &snap)
+{
+    return Window{energy(snap), snap.time.user + snap.time.system - snap.time.looped};
+}
+
 bool Measure::start()
 {
     if (_running)
         return true;
 
-    if (!_proc->valid() || _proc->finished())
+    return start(_proc->snapshot());
+}
+
+bool Measure::start(const ProcessSnapshot &snap)
+{
+    if (_running)
+        return true;
+
+    if (!snap.valid() || snap.finished())
         return false;
 
-    update_times();
+    update_times(snap);
+
+    if (_count && !_counters)
+        _counters.reset(new Counters{_proc->pid(), _count_uncore});
+
+    if (this->start_(snap)) {
+        /* Count exactly while the energy is measured */
+        if (_counters)
+            _counters->enable();
+
+        if (_sample)
+            _window = window(snap);
 
-    if (this->start_()) {
         _running = true;
         return true;
     } else {
@@ -88,12 +161,28 @@ bool Measure::stop()
     if (!_running)
         return true;
 
-    if (!_proc->valid())
+    return stop(_proc->snapshot());
+}
+
+bool Measure::stop(const ProcessSnapshot &snap)
+{
+    if (!_running)
+        return true;
+
+    if (!snap.valid())
         return false;
 
-    update_times();
+    update_times(snap);
+
+    if (this->stop_(snap)) {
+        if (_counters)
+            _counters->disable();
+
+        if (_sample) {
+            auto end = window(snap);
+            _windows.push_back(Window{end.energy - _window.energy, end.time - _window.time});
+        }
 
-    if (this->stop_()) {
         _running = false;
         return true;
     } else {
@@ -103,8 +192,10 @@ bool Measure::stop()
 
 void Measure::reset()
 {
-    if (_proc->valid()) {
-        _last_proc_time = _proc->time();
+    auto snap = _proc->snapshot();
+
+    if (snap.valid()) {
+        _last_proc_time = snap.time;
     } else {
         _last_proc_time = {};
     }
@@ -112,12 +203,65 @@ void Measure::reset()
     _measured = 0;
     _not_measured = 0;
 
+    if (_counters)
+        _counters->reset();
+
+    _windows.clear();
+
     this->reset_();
+
+    if (_sample && _running)
+        _window = window(snap);
+}
+
+void Measure::count(bool uncore)
+{
+    _count = true;
+    _count_uncore = uncore;
+}
+
+bool Measure::counting() const
+{
+    return _count;
+}
+
+void Measure::open_counters()
+{
+    if (_count && !_counters)
+        _counters.reset(new Counters{_proc->pid(), _count_uncore, true});
+}
+
+CounterValues Measure::counters() const
+{
+    if (!_counters)
+        return CounterValues{};
+
+    return _counters->read();
+}
+
+void Measure::sample()
+{
+    _sample = true;
+}
+
+Estimate Measure::estimate(const ProcessSnapshot &snap)
+{
+    update_times(snap);
+
+    auto windows = _windows;
+
+    /* The process may have finished while it was measured */
+    if (_sample && _running) {
+        auto end = window(snap);
+        windows.push_back(Window{end.energy - _window.energy, end.time - _window.time});
+    }
+
+    return ::estimate(windows, _measured + _not_measured);
 }
 
-double Measure::rate()
+double Measure::rate(const ProcessSnapshot &snap)
 {
-    update_times();
+    update_times(snap);
 
     if ((_measured + _not_measured) == 0)
         return 0;
@@ -132,137 +276,399 @@ const std::string NoMeasure::name = {"none"};
 
 const std::string ETeamMeasure::name = {"eteam"};
 
-ETeamMeasure::ETeamMeasure(Process *proc) :
-    Measure{proc}
+ETeamMeasure::ETeamMeasure(Process *proc, Aggregation agg) :
+    Measure{proc, agg}, _tree{nullptr}, _started{}
 {}
 
-bool ETeamMeasure::start_()
+ETeamMeasure::~ETeamMeasure()
+{
+    if (_tree)
+        eteam_tree_close(_tree);
+}
+
+bool ETeamMeasure::start_(const ProcessSnapshot &)
 {
-    return start_energy(this->_proc->pid()) == 0;
+    /* Start tracking the process tree with the first measurement, so that
+     * exited children are remembered from then on. */
+    if (_aggregation == TREE && !_tree)
+        _tree = eteam_tree_open(this->_proc->pid());
+
+    if (start_energy(this->_proc->pid()) < 0)
+        return false;
+
+    start_descendants();
+    return true;
 }
 
-bool ETeamMeasure::stop_()
+bool ETeamMeasure::stop_(const ProcessSnapshot &snap)
 {
-    if (this->_proc->finished())
+    stop_descendants();
+
+    if (snap.finished())
         return true;
 
     return stop_energy(this->_proc->pid()) == 0;
 }
 
+void ETeamMeasure::start_descendants()
+{
+    if (!_tree)
+        return;
+
+    std::vector<pid_t> pids(16);
+    int count;
+
+    while ((count = eteam_tree_pids(_tree, pids.data(), pids.size())) > static_cast<int>(pids.size()))
+        pids.resize(count * 2);
+
+    /* E-Team is only started for the process itself, hence start it for all
+     * descendants as soon as we see them. Those which exited in the meantime
+     * simply fail. */
+    std::vector<pid_t> fresh;
+
+    for (int i = 0; i < count; ++i) {
+        if (pids[i] != this->_proc->pid() && _started.insert(pids[i]).second)
+            fresh.push_back(pids[i]);
+    }
+
+    if (!fresh.empty())
+        start_energy_many(fresh.data(), fresh.size(), nullptr);
+}
+
+void ETeamMeasure::stop_descendants()
+{
+    std::vector<pid_t> pids{_started.begin(), _started.end()};
+
+    if (!pids.empty())
+        stop_energy_many(pids.data(), pids.size(), nullptr);
+
+    _started.clear();
+}
+
+void ETeamMeasure::poll()
+{
+    if (!_tree || !this->_running)
+        return;
+
+    struct energy te;
+
+    if (eteam_tree_read(_tree, &te) == 0)
+        start_descendants();
+}
+
 void ETeamMeasure::reset_()
 {
     this->_running = false;
 }
 
-Energy ETeamMeasure::energy()
+Energy ETeamMeasure::energy(const ProcessSnapshot &snap)
 {
-    Energy e;
-
-    if (!_proc->valid())
-        return e;
+    if (!snap.valid())
+        return Energy{};
 
-    std::stringstream path;
-    path << "/proc/" << _proc->pid() << "/energystat";
+    if (_aggregation == TREE && _tree) {
+        struct energy te;
 
-    std::ifstream estat{path.str(), std::ios::in};
+        if (eteam_tree_read(_tree, &te) < 0)
+            return Energy{};
 
-    if (estat.is_open()) {
-        estat >> e.package >> e.dram >> e.core >> e.gpu >> e.loops;
+        Energy e{snap.energy};
+        e.package = te.package;
+        e.core = te.core;
+        e.dram = te.dram;
+        e.gpu = te.gpu;
 
-        estat.close();
+        return e;
     }
 
-    return e;
+    /* The snapshot already contains the E-Team energy counters of the process. */
+    return snap.energy;
 }
 
 
 namespace rapl {
 
-enum class msr_nr : unsigned int {
-    PKG = 0x611,
-    CORE = 0x639,
-    DRAM = 0x619,
-    GPU = 0x641,
+/* MSR_RAPL_POWER_UNIT style register with the power and energy status units */
+constexpr Register power_unit(unsigned int nr)
+{
+    return Register{nr, 0, 0xf};
+}
+
+constexpr Register energy_unit(unsigned int nr)
+{
+    return Register{nr, 8, 0x1f00};
+}
 
-    UNIT = 0x606
-};
+/* 32-bit energy status counter */
+constexpr Register energy_status(unsigned int nr)
+{
+    return Register{nr, 0, 0xffffffff};
+}
 
-enum class msr_offset : unsigned int {
-    PKG = 0,
-    CORE = PKG,
-    DRAM = PKG,
-    GPU = PKG,
+constexpr Register unavailable{0, 0, 0};
+
+constexpr Descriptor intel = {
+    "intel",
+    energy_unit(0x606),                 /* MSR_RAPL_POWER_UNIT */
+    power_unit(0x606),
+    Register{0x614, 0, 0x7fff},         /* MSR_PKG_POWER_INFO (thermal spec power) */
+    energy_status(0x611),               /* MSR_PKG_ENERGY_STATUS */
+    energy_status(0x639),               /* MSR_PP0_ENERGY_STATUS */
+    energy_status(0x619),               /* MSR_DRAM_ENERGY_STATUS */
+    energy_status(0x641),               /* MSR_PP1_ENERGY_STATUS */
+    unavailable
+};
 
-    UNIT = 8
+constexpr Descriptor amd = {
+    "amd",
+    energy_unit(0xc0010299),            /* MSR_AMD_RAPL_POWER_UNIT */
+    power_unit(0xc0010299),
+    unavailable,
+    energy_status(0xc001029b),          /* MSR_AMD_PKG_ENERGY_STATUS */
+    unavailable,                        /* summed up from the cores */
+    unavailable,
+    unavailable,
+    energy_status(0xc001029a)           /* MSR_AMD_CORE_ENERGY_STATUS */
 };
 
-enum class msr_mask : unsigned int {
-    PKG = 0xffffffff,
-    CORE = PKG,
-    DRAM = PKG,
-    GPU = PKG,
+/* The CPU vendor string of cpuid leaf 0 */
+static std::string cpu_vendor()
+{
+    unsigned int eax, regs[3];
+
+    if (!__get_cpuid(0, &eax, &regs[0], &regs[2], &regs[1]))
+        return {};
+
+    return std::string{reinterpret_cast<const char *>(regs), sizeof(regs)};
+}
+
+const Descriptor &Descriptor::get()
+{
+    static const Descriptor &desc = [] () -> const Descriptor & {
+        auto vendor = cpu_vendor();
+
+        if (vendor == "AuthenticAMD" || vendor == "HygonGenuine")
+            return amd;
+
+        return intel;
+    }();
+
+    return desc;
+}
+
+/**
+ * Keeps the msr device files of all used CPUs open, so that reading a register
+ * only costs a single pread.
+ **/
+class Reader
+{
+   private:
+    std::vector<int> _fds;
+
+    /* Registers of the descriptor that the CPU does not implement */
+    std::vector<unsigned int> _missing;
+
+    int fd(unsigned int cpu);
+
+   public:
+    static Reader &instance();
+
+   public:
+    Reader();
+    Reader(const Reader&) = delete;
+
+    ~Reader();
+
+    Reader& operator=(const Reader&) = delete;
 
-    UNIT = 0x1f00
+    uint64_t read(unsigned int cpu, unsigned int nr);
+
+    /* Whether the register is available and implemented by the CPU */
+    bool readable(const Register &reg) const;
+
+    /* Read the field described by the register, 0 if it is not readable */
+    unsigned long read(unsigned int cpu, const Register &reg);
 };
 
-template <typename EnumClass>
-auto to_underlying(const EnumClass &e) -> typename std::underlying_type<EnumClass>::type
+Reader &Reader::instance()
 {
-    return static_cast<typename std::underlying_type<EnumClass>::type>(e);
+    static Reader reader;
+
+    return reader;
 }
 
-static unsigned int read_msr(const msr_nr &nr, const msr_offset &offset, const msr_mask &mask)
+Reader::Reader() :
+    _fds{}, _missing{}
 {
-    int msr = open("/dev/cpu/0/msr", O_RDONLY);
+    auto &desc = Descriptor::get();
 
-    if (msr > 0) {
+    /* Some parts do not implement all registers of their vendor, e.g. PP0 and
+     * PP1 on many Xeons, and reading them fails with EIO. Only the units and
+     * the package register are required, they throw when they are read. */
+    for (auto &reg : {desc.power_info, desc.core, desc.dram, desc.gpu, desc.core_energy}) {
         uint64_t val;
 
-        lseek(msr, to_underlying(nr), SEEK_SET);
-        read(msr, &val, sizeof(uint64_t));
-        close(msr);
+        if (reg.available() && pread(fd(0), &val, sizeof(val), reg.nr) < 0 && errno == EIO)
+            _missing.push_back(reg.nr);
+    }
+}
+
+Reader::~Reader()
+{
+    for (auto fd : _fds) {
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+int Reader::fd(unsigned int cpu)
+{
+    if (cpu >= _fds.size())
+        _fds.resize(cpu + 1, -1);
 
-        return (val & to_underlying(mask)) >> to_underlying(offset);
-    } else {
-        throw std::runtime_error{"Failed to open msr file!"};
+    if (_fds[cpu] < 0) {
+        std::string path = "/dev/cpu/" + std::to_string(cpu) + "/msr";
+
+        _fds[cpu] = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (_fds[cpu] < 0)
+            throw std::runtime_error{"Failed to open msr file!"};
     }
+
+    return _fds[cpu];
+}
+
+uint64_t Reader::read(unsigned int cpu, unsigned int nr)
+{
+    uint64_t val;
+
+    if (pread(fd(cpu), &val, sizeof(val), nr) != sizeof(val))
+        throw std::runtime_error{"Failed to read msr!"};
+
+    return val;
+}
+
+bool Reader::readable(const Register &reg) const
+{
+    return reg.available() && std::find(_missing.begin(), _missing.end(), reg.nr) == _missing.end();
+}
+
+unsigned long Reader::read(unsigned int cpu, const Register &reg)
+{
+    if (!readable(reg))
+        return 0;
+
+    return (read(cpu, reg.nr) & reg.mask) >> reg.shift;
 }
 
-Value Value::read()
+Value Value::read(unsigned int cpu)
 {
+    auto &reader = Reader::instance();
+    auto &desc = Descriptor::get();
     Value val;
 
-    val.pkg = read_msr(msr_nr::PKG, msr_offset::PKG, msr_mask::PKG);
-    val.core = read_msr(msr_nr::CORE, msr_offset::CORE, msr_mask::CORE);
-    val.dram = read_msr(msr_nr::DRAM, msr_offset::DRAM, msr_mask::DRAM);
-    val.gpu = read_msr(msr_nr::GPU, msr_offset::GPU, msr_mask::GPU);
+    /* All domains are read in one go, so that they describe the same moment. */
+    val.pkg = reader.read(cpu, desc.pkg);
+    val.core = reader.read(cpu, desc.core);
+    val.dram = reader.read(cpu, desc.dram);
+    val.gpu = reader.read(cpu, desc.gpu);
 
     return val;
 }
 
+const std::vector<topology::Package> &packages()
+{
+    static std::vector<topology::Package> pkgs = [] {
+        auto found = topology::packages();
 
-class Unit {
-   private:
-    static bool _initialized;
-    static unsigned int _unit;
+        /* Without topology information, at least measure the first package. */
+        if (found.empty())
+            found.push_back(topology::Package{0, 0});
 
-   public:
-    static unsigned int get();
-};
+        return found;
+    }();
+
+    return pkgs;
+}
+
+const std::vector<topology::Core> &cores()
+{
+    static std::vector<topology::Core> cores = [] {
+        /* Only needed if the cores have their own counters */
+        if (!Reader::instance().readable(Descriptor::get().core_energy))
+            return std::vector<topology::Core>{};
 
-bool Unit::_initialized = false;
-unsigned int Unit::_unit = 1;
+        return topology::cores();
+    }();
 
-unsigned int Unit::get()
+    return cores;
+}
+
+size_t package_index(unsigned int id)
 {
-    if (!_initialized) {
-        auto val = read_msr(msr_nr::UNIT, msr_offset::UNIT, msr_mask::UNIT);
+    auto &pkgs = packages();
 
-        _unit = 1000000 / (1 << val);
-        _initialized = true;
+    for (size_t i = 0; i < pkgs.size(); ++i) {
+        if (pkgs[i].id == id)
+            return i;
     }
 
-    return _unit;
+    return 0;
+}
+
+
+/**
+ * Whether the DRAM domain of the CPU uses the fixed energy unit of 15.3 uJ
+ * instead of the one in MSR_RAPL_POWER_UNIT (see the Intel datasheets of the
+ * server parts, the Linux RAPL driver does the same).
+ **/
+static bool fixed_dram_unit()
+{
+    static const unsigned int models[] = {
+        0x3f,   /* Haswell-X */
+        0x4f,   /* Broadwell-X */
+        0x56,   /* Broadwell-D */
+        0x55,   /* Skylake-X */
+        0x57,   /* Xeon Phi (Knights Landing) */
+        0x85,   /* Xeon Phi (Knights Mill) */
+        0x6a,   /* Ice Lake-X */
+        0x6c,   /* Ice Lake-D */
+        0x8f,   /* Sapphire Rapids-X */
+        0xcf    /* Emerald Rapids-X */
+    };
+
+    unsigned int eax, ebx, ecx, edx;
+
+    /* Only Intel family 6 */
+    if (&Descriptor::get() != &intel || !__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+
+    unsigned int family = (eax >> 8) & 0xf;
+    unsigned int model = ((eax >> 4) & 0xf) | ((eax >> 12) & 0xf0);
+
+    return family == 6 && std::find(std::begin(models), std::end(models), model) != std::end(models);
+}
+
+const Units &Units::get()
+{
+    static const Units units = [] {
+        unsigned int esu = Reader::instance().read(0, Descriptor::get().unit);
+
+        /* 15.3 uJ = 2^-16 J */
+        return Units{esu, esu, fixed_dram_unit() ? 16 : esu, esu};
+    }();
+
+    return units;
+}
+
+unsigned long long to_microjoules(unsigned long long ticks, unsigned int esu)
+{
+    /* ticks * 10^6 / 2^esu, rounded to the nearest uJ, without overflowing or
+     * loosing precision in between */
+    unsigned long long mask = (1ULL << esu) - 1;
+    unsigned long long full = (ticks >> esu) * 1000000ULL;
+    unsigned long long frac = (ticks & mask) * 1000000ULL;
+
+    return full + ((frac + (1ULL << esu >> 1)) >> esu);
 }
 
 unsigned long calculate_consumed(const unsigned long start, const unsigned long end)
@@ -276,60 +682,1332 @@ unsigned long calculate_consumed(const unsigned long start, const unsigned long
     }
 }
 
-Energy consumed_energy(const Value &start, const Value &end)
+Value &Value::operator+=(const Value &o)
+{
+    pkg += o.pkg;
+    core += o.core;
+    dram += o.dram;
+    gpu += o.gpu;
+
+    return *this;
+}
+
+Value consumed_ticks(const Value &start, const Value &end)
+{
+    Value v;
+
+    v.pkg = calculate_consumed(start.pkg, end.pkg);
+    v.core = calculate_consumed(start.core, end.core);
+    v.dram = calculate_consumed(start.dram, end.dram);
+    v.gpu = calculate_consumed(start.gpu, end.gpu);
+
+    return v;
+}
+
+Energy to_energy(const Value &ticks)
 {
-    Energy e;
+    auto &units = Units::get();
+    Energy e{};
 
-    e.package = calculate_consumed(start.pkg, end.pkg) * Unit::get();
-    e.core = calculate_consumed(start.core, end.core) * Unit::get();
-    e.dram = calculate_consumed(start.dram, end.dram) * Unit::get();
-    e.gpu = calculate_consumed(start.gpu, end.gpu) * Unit::get();
+    e.package = to_microjoules(ticks.pkg, units.pkg);
+    e.core = to_microjoules(ticks.core, units.core);
+    e.dram = to_microjoules(ticks.dram, units.dram);
+    e.gpu = to_microjoules(ticks.gpu, units.gpu);
 
     return e;
 }
 
-} /* namespace rapl */
+const std::chrono::milliseconds Tracker::interval = std::chrono::milliseconds{100};
 
+Tracker &Tracker::instance()
+{
+    static Tracker tracker;
 
-const std::string MSRMeasure::name = {"msr"};
+    return tracker;
+}
 
-MSRMeasure::MSRMeasure(Process *proc) :
-    Measure{proc}, _accum_energy{}, _last_rapl{}
+Tracker::Tracker() :
+    _mutex{}, _cond{}, _thread{}, _users{0}, _generation{0}, _period{0}, _last{}, _totals{},
+    _runtimes{}, _sampled{}, _followers{}
 {}
 
-bool MSRMeasure::start_()
+Tracker::~Tracker()
 {
-    _last_rapl = rapl::Value::read();
+    std::unique_lock<std::mutex> lock{_mutex};
+    stop(lock);
+}
 
-    return true;
+std::chrono::milliseconds Tracker::period()
+{
+    auto &reader = Reader::instance();
+    auto &desc = Descriptor::get();
+
+    /* Energy until the first of the 32-bit counters wraps around (in J) */
+    auto &units = Units::get();
+    auto esu = std::max({units.pkg, units.core, units.dram, units.gpu});
+    double wrap = static_cast<double>(1ULL << 32) / (1ULL << esu);
+
+    /* Thermal design power (in W) -- assume a lot if the CPU doesn't tell */
+    auto pu = reader.read(0, desc.power_unit);
+    double tdp = reader.read(0, desc.power_info) / static_cast<double>(1ULL << pu);
+
+    if (tdp <= 0)
+        tdp = 500;
+
+    /* The package may draw more than its TDP for a while, hence sample the
+     * counters a lot more often than strictly necessary. */
+    auto ms = static_cast<long>(wrap / (4 * tdp) * 1000);
+
+    return std::chrono::milliseconds{std::max(10L, std::min(ms, 60000L))};
 }
 
-bool MSRMeasure::stop_()
+std::vector<unsigned long long> Tracker::busy_cores()
 {
-    auto current_rapl = rapl::Value::read();
-    _accum_energy += consumed_energy(_last_rapl, current_rapl);
+    auto &cs = cores();
+    std::vector<unsigned long long> busy(cs.size());
+
+    auto now = std::chrono::steady_clock::now();
+    unsigned long long elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _sampled).count();
+
+    /* The statistics read as zero if they are disabled at runtime */
+    std::vector<unsigned long long> runtimes;
+    bool schedstat = procfs::read_cpu_runtimes(runtimes) &&
+        std::any_of(runtimes.begin(), runtimes.end(), [](unsigned long long r) { return r > 0; });
+
+    for (size_t c = 0; c < cs.size(); ++c) {
+        for (auto cpu : cs[c].cpus) {
+            /* Without scheduler statistics the CPU counts as busy all the time */
+            if (!schedstat || cpu >= runtimes.size())
+                busy[c] += elapsed;
+            else if (cpu < _runtimes.size() && _runtimes[cpu] <= runtimes[cpu])
+                busy[c] += runtimes[cpu] - _runtimes[cpu];
+        }
+    }
 
-    return true;
+    _runtimes = std::move(runtimes);
+    _sampled = now;
+
+    return busy;
 }
 
-void MSRMeasure::reset_()
+std::vector<unsigned long long> Tracker::used_cores(Follower &f)
 {
-    _accum_energy = {};
+    auto &cs = cores();
+    std::vector<unsigned long long> used(cs.size());
+    std::map<pid_t, unsigned long long> runtimes;
 
-    if (this->_running)
-        _last_rapl = rapl::Value::read();
+    /* The threads of the process and of all its descendants */
+    std::vector<pid_t> pids{f.pid}, tids(16);
+
+    while (!pids.empty()) {
+        pid_t pid = pids.back();
+        pids.pop_back();
+
+        int count;
+        while ((count = eteam_threads(pid, tids.data(), tids.size())) > static_cast<int>(tids.size()))
+            tids.resize(count * 2);
+
+        for (int i = 0; i < count; ++i) {
+            procfs::Stat st;
+            unsigned long long runtime;
+
+            if (!procfs::read_task_stat(pid, tids[i], st))
+                continue;
+
+            procfs::read_task_children(pid, tids[i], pids);
+
+            /* Only whole clock ticks without scheduler statistics */
+            if (!procfs::read_task_runtime(pid, tids[i], runtime) || runtime == 0)
+                runtime = (st.utime + st.stime) * (1000000000ULL / procfs::clock_ticks());
+
+            runtimes.emplace(tids[i], runtime);
+
+            /* New tasks (and reused tids) ran all of their time since the last
+             * sample. A task only counts for the core it last ran on. */
+            auto it = f.runtimes.find(tids[i]);
+            auto last = (it != f.runtimes.end() && it->second <= runtime) ? it->second : 0;
+
+            if (runtime == last)
+                continue;
+
+            for (size_t c = 0; c < cs.size(); ++c) {
+                if (std::find(cs[c].cpus.begin(), cs[c].cpus.end(), st.processor) != cs[c].cpus.end()) {
+                    used[c] += runtime - last;
+                    break;
+                }
+            }
+        }
+    }
+
+    f.runtimes = std::move(runtimes);
+    return used;
 }
 
-Energy MSRMeasure::energy()
+void Tracker::sample()
 {
-    if (this->_running) {
-        auto current_rapl = rapl::Value::read();
+    auto &reader = Reader::instance();
+    auto &reg = Descriptor::get().core_energy;
+    auto &pkgs = packages();
+    auto &cs = cores();
+
+    if (_last.packages.empty()) {
+        _last.packages.resize(pkgs.size());
+        _last.cores.resize(cs.size());
+        _totals.packages.resize(pkgs.size());
+        _totals.cores.resize(cs.size());
 
-        _accum_energy += consumed_energy(_last_rapl, current_rapl);
-        _last_rapl = current_rapl;
+        for (size_t i = 0; i < pkgs.size(); ++i)
+            _last.packages[i] = Value::read(pkgs[i].cpu);
+
+        for (size_t i = 0; i < cs.size(); ++i)
+            _last.cores[i] = reader.read(cs[i].cpus.front(), reg);
+
+        busy_cores();
+        return;
     }
 
-    return _accum_energy;
+    for (size_t i = 0; i < pkgs.size(); ++i) {
+        auto cur = Value::read(pkgs[i].cpu);
+
+        _totals.packages[i] += consumed_ticks(_last.packages[i], cur);
+        _last.packages[i] = cur;
+    }
+
+    auto busy = busy_cores();
+
+    std::vector<std::vector<unsigned long long>> used;
+    for (auto &f : _followers)
+        used.push_back(used_cores(f.second));
+
+    for (size_t i = 0; i < cs.size(); ++i) {
+        auto cur = reader.read(cs[i].cpus.front(), reg);
+        auto ticks = calculate_consumed(_last.cores[i], cur);
+
+        _totals.cores[i] += ticks;
+        _last.cores[i] = cur;
+
+        /* Every follower gets the share of the time the core was busy that
+         * its tasks ran on it */
+        size_t j = 0;
+        for (auto &f : _followers) {
+            auto time = used[j++][i];
+
+            if (time == 0)
+                continue;
+
+            double share = time < busy[i] ? static_cast<double>(time) / busy[i] : 1.0;
+            f.second.ticks[package_index(cs[i].package)] += std::llround(ticks * share);
+        }
+    }
+}
+
+void Tracker::run(unsigned int generation)
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+
+    auto period = [&] { return _followers.empty() ? _period : std::min(_period, interval); };
+
+    while (!_cond.wait_for(lock, period(), [&] { return _generation != generation; })) {
+        try {
+            sample();
+        } catch (std::runtime_error &) {
+            /* Try again in the next period */
+        }
+    }
+}
+
+void Tracker::stop(std::unique_lock<std::mutex> &lock)
+{
+    /* Tell the current thread to exit and wait for it without holding the
+     * lock, which it needs to notice. */
+    _generation++;
+
+    std::thread thread{std::move(_thread)};
+    lock.unlock();
+
+    _cond.notify_all();
+
+    if (thread.joinable())
+        thread.join();
+}
+
+void Tracker::acquire()
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    if (_users++ > 0)
+        return;
+
+    try {
+        _period = period();
+
+        /* Start from scratch, the counters might have wrapped in the meantime */
+        _last.packages.clear();
+        sample();
+    } catch (...) {
+        _users--;
+        throw;
+    }
+
+    _thread = std::thread{&Tracker::run, this, _generation};
+}
+
+void Tracker::release()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+
+    if (--_users == 0)
+        stop(lock);
+}
+
+Totals Tracker::totals()
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    sample();
+    return _totals;
+}
+
+void Tracker::follow(const void *owner, pid_t pid)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    if (cores().empty())
+        return;
+
+    /* Everything until now is not accounted to the process */
+    sample();
+
+    Follower f{pid, {}, std::vector<unsigned long>(packages().size())};
+    used_cores(f);
+
+    _followers[owner] = std::move(f);
+
+    /* Wake up the thread to pick up the shorter period */
+    _cond.notify_all();
+}
+
+void Tracker::unfollow(const void *owner)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    _followers.erase(owner);
+}
+
+std::vector<unsigned long> Tracker::followed(const void *owner)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    auto it = _followers.find(owner);
+    if (it == _followers.end())
+        return std::vector<unsigned long>(packages().size());
+
+    sample();
+    return it->second.ticks;
+}
+
+} /* namespace rapl */
+
+
+const std::string MSRMeasure::name = {"msr"};
+
+MSRMeasure::MSRMeasure(Process *proc) :
+    Measure{proc}, _tracker{rapl::Tracker::instance()}, _accum_ticks(rapl::packages().size()),
+    _last_rapl{}, _last_cores(rapl::packages().size())
+{}
+
+MSRMeasure::~MSRMeasure()
+{
+    if (this->_running) {
+        _tracker.unfollow(this);
+        _tracker.release();
+    }
+}
+
+void MSRMeasure::update()
+{
+    auto current = _tracker.totals();
+    auto cores = _tracker.followed(this);
+
+    for (size_t i = 0; i < current.packages.size(); ++i)
+        _accum_ticks[i] += consumed_ticks(_last_rapl.packages[i], current.packages[i]);
+
+    /* CPUs with per core counters have no core domain per package */
+    for (size_t i = 0; i < cores.size(); ++i)
+        _accum_ticks[i].core += cores[i] - _last_cores[i];
+
+    _last_rapl = std::move(current);
+    _last_cores = std::move(cores);
+}
+
+bool MSRMeasure::start_(const ProcessSnapshot &)
+{
+    _tracker.acquire();
+
+    /* Account the per core counters of the cores that the program runs on */
+    _tracker.follow(this, this->_proc->pid());
+
+    _last_rapl = _tracker.totals();
+    _last_cores = _tracker.followed(this);
+
+    return true;
+}
+
+bool MSRMeasure::stop_(const ProcessSnapshot &)
+{
+    update();
+
+    _tracker.unfollow(this);
+    _tracker.release();
+
+    return true;
+}
+
+void MSRMeasure::reset_()
+{
+    for (auto &t : _accum_ticks)
+        t = {};
+
+    if (this->_running) {
+        _last_rapl = _tracker.totals();
+        _last_cores = _tracker.followed(this);
+    }
+}
+
+Energy MSRMeasure::energy(const ProcessSnapshot &snap)
+{
+    Energy sum{};
+
+    for (auto &e : packages(snap))
+        sum += e;
+
+    return sum;
+}
+
+std::vector<Energy> MSRMeasure::packages(const ProcessSnapshot &)
+{
+    if (this->_running)
+        update();
+
+    /* Only convert the raw values now to not accumulate rounding errors */
+    std::vector<Energy> energy;
+    for (auto &t : _accum_ticks)
+        energy.push_back(rapl::to_energy(t));
+
+    return energy;
+}
+
+/* The first line of a (sysfs) file, empty if it could not be read. */
+static std::string read_line(const std::string &path)
+{
+    std::ifstream file{path};
+    std::string line;
+
+    std::getline(file, line);
+    return line;
+}
+
+
+namespace powercap {
+
+const std::string sysfs_root = {"/sys/class/powercap"};
+
+/* Parse the numbers of a 'intel-rapl:<N>[:<M>...]' zone name. */
+static std::vector<long> zone_numbers(const std::string &name)
+{
+    static const std::string prefix = {"intel-rapl"};
+    std::vector<long> nrs;
+
+    if (name.compare(0, prefix.size(), prefix) != 0)
+        return {};
+
+    const char *pos = name.c_str() + prefix.size();
+
+    while (*pos == ':') {
+        char *end;
+        long nr = std::strtol(pos + 1, &end, 10);
+
+        if (end == pos + 1)
+            return {};
+
+        nrs.push_back(nr);
+        pos = end;
+    }
+
+    return *pos == '\0' ? nrs : std::vector<long>{};
+}
+
+static std::vector<std::string> subdirs(const std::string &path, size_t depth)
+{
+    std::vector<std::string> result;
+    DIR *dir = opendir(path.c_str());
+
+    if (!dir)
+        return result;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (zone_numbers(entry->d_name).size() == depth)
+            result.push_back(entry->d_name);
+    }
+
+    closedir(dir);
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+Reader &Reader::instance()
+{
+    static Reader reader;
+
+    return reader;
+}
+
+Reader::Reader(const std::string &root) :
+    _zones{}, _packages{0}
+{
+    /* package id -> path of its zone */
+    std::map<unsigned int, std::string> pkgs;
+
+    for (auto &zone : subdirs(root, 1)) {
+        auto name = read_line(root + "/" + zone + "/name");
+        unsigned int id;
+
+        /* Skip other top level zones such as 'psys' */
+        if (std::sscanf(name.c_str(), "package-%u", &id) == 1)
+            pkgs.emplace(id, root + "/" + zone);
+    }
+
+    for (auto &p : pkgs) {
+        auto &path = p.second;
+
+        add_zone(path, _packages, Zone::PKG);
+
+        for (auto &sub : subdirs(path, 2)) {
+            auto name = read_line(path + "/" + sub + "/name");
+
+            if (name == "core")
+                add_zone(path + "/" + sub, _packages, Zone::CORE);
+            else if (name == "dram")
+                add_zone(path + "/" + sub, _packages, Zone::DRAM);
+            else if (name == "uncore")
+                add_zone(path + "/" + sub, _packages, Zone::GPU);
+        }
+
+        _packages++;
+    }
+
+    if (_packages == 0)
+        throw std::runtime_error{"No RAPL zones found in powercap!"};
+}
+
+Reader::~Reader()
+{
+    for (auto &zone : _zones)
+        close(zone.fd);
+}
+
+void Reader::add_zone(const std::string &path, unsigned int package, Zone::Domain domain)
+{
+    /* 'energy_uj' is only readable by root on newer kernels unless the
+     * administrator granted access to it. */
+    int fd = open((path + "/energy_uj").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error{"Failed to open powercap energy file!"};
+
+    unsigned long long max = std::strtoull(read_line(path + "/max_energy_range_uj").c_str(), nullptr, 10);
+
+    /* Without the range, a wrap-around would turn into a huge delta. The
+     * subzones are optional, but the package zone is required. */
+    if (max == 0) {
+        close(fd);
+
+        if (domain == Zone::PKG)
+            throw std::runtime_error{"Failed to read the energy range of a powercap zone!"};
+
+        return;
+    }
+
+    _zones.push_back(Zone{package, domain, fd, max});
+}
+
+std::vector<unsigned long long> Reader::read() const
+{
+    std::vector<unsigned long long> values(_zones.size());
+    char buf[32];
+
+    for (size_t i = 0; i < _zones.size(); ++i) {
+        auto len = pread(_zones[i].fd, buf, sizeof(buf) - 1, 0);
+        if (len <= 0)
+            throw std::runtime_error{"Failed to read powercap energy file!"};
+
+        buf[len] = '\0';
+        values[i] = std::strtoull(buf, nullptr, 10);
+    }
+
+    return values;
+}
+
+void Reader::accumulate(const std::vector<unsigned long long> &start, const std::vector<unsigned long long> &end,
+        std::vector<Energy> &energy) const
+{
+    for (size_t i = 0; i < _zones.size(); ++i) {
+        auto &zone = _zones[i];
+
+        /* The counter wraps around to 0 after reaching the maximum of its
+         * range, i.e. modulo max + 1. Only a single wrap-around between two
+         * readings can be detected. */
+        unsigned long long delta = start[i] <= end[i] ? end[i] - start[i] : zone.max - start[i] + end[i] + 1;
+
+        switch (zone.domain) {
+            case Zone::PKG:
+                energy[zone.package].package += delta;
+                break;
+            case Zone::CORE:
+                energy[zone.package].core += delta;
+                break;
+            case Zone::DRAM:
+                energy[zone.package].dram += delta;
+                break;
+            case Zone::GPU:
+                energy[zone.package].gpu += delta;
+                break;
+        }
+    }
+}
+
+} /* namespace powercap */
+
+
+const std::string PowercapMeasure::name = {"powercap"};
+
+PowercapMeasure::PowercapMeasure(Process *proc) :
+    Measure{proc}, _reader{powercap::Reader::instance()}, _accum_energy(_reader.packages()), _last{}
+{}
+
+void PowercapMeasure::update()
+{
+    auto current = _reader.read();
+
+    _reader.accumulate(_last, current, _accum_energy);
+    _last = std::move(current);
+}
+
+bool PowercapMeasure::start_(const ProcessSnapshot &)
+{
+    _last = _reader.read();
+
+    return true;
+}
+
+bool PowercapMeasure::stop_(const ProcessSnapshot &)
+{
+    update();
+
+    return true;
+}
+
+void PowercapMeasure::reset_()
+{
+    for (auto &e : _accum_energy)
+        e = {};
+
+    if (this->_running)
+        _last = _reader.read();
+}
+
+Energy PowercapMeasure::energy(const ProcessSnapshot &snap)
+{
+    Energy sum{};
+
+    for (auto &e : packages(snap))
+        sum += e;
+
+    return sum;
+}
+
+std::vector<Energy> PowercapMeasure::packages(const ProcessSnapshot &)
+{
+    if (this->_running)
+        update();
+
+    return _accum_energy;
+}
+
+namespace perf {
+
+const std::string pmu_root = {"/sys/bus/event_source/devices/power"};
+
+Reader &Reader::instance()
+{
+    static Reader reader;
+
+    return reader;
+}
+
+Reader::Reader(const std::string &root) :
+    _leaders{}, _fds{}, _events{}
+{
+    static const std::pair<const char *, powercap::Zone::Domain> domains[] = {
+        {"energy-pkg", powercap::Zone::PKG},
+        {"energy-cores", powercap::Zone::CORE},
+        {"energy-ram", powercap::Zone::DRAM},
+        {"energy-gpu", powercap::Zone::GPU}
+    };
+
+    auto type = read_line(root + "/type");
+    if (type.empty())
+        throw std::runtime_error{"No RAPL perf PMU available!"};
+
+    /* The PMU names one CPU per package on which its events can be opened */
+    auto cpus = topology::parse_cpus(read_line(root + "/cpumask"));
+
+    for (auto cpu : cpus) {
+        int leader = -1;
+
+        for (auto &d : domains) {
+            std::string event = root + "/events/" + d.first;
+            unsigned long long config;
+
+            if (std::sscanf(read_line(event).c_str(), "event=%llx", &config) != 1)
+                continue;
+
+            long double scale = std::strtold(read_line(event + ".scale").c_str(), nullptr);
+            if (read_line(event + ".unit") != "Joules" || scale <= 0)
+                continue;
+
+            perf_event_attr attr{};
+            attr.type = std::strtoul(type.c_str(), nullptr, 10);
+            attr.size = sizeof(attr);
+            attr.config = config;
+            attr.read_format = PERF_FORMAT_GROUP;
+
+            int fd = syscall(SYS_perf_event_open, &attr, -1, cpu, leader, PERF_FLAG_FD_CLOEXEC);
+            if (fd < 0)
+                continue;
+
+            if (leader < 0) {
+                leader = fd;
+                _leaders.push_back(fd);
+            }
+
+            _fds.push_back(fd);
+            _events.push_back(Event{static_cast<unsigned int>(_leaders.size() - 1), d.second, scale * 1000000.0L});
+        }
+    }
+
+    if (_leaders.empty())
+        throw std::runtime_error{"Failed to open the RAPL perf events!"};
+}
+
+Reader::~Reader()
+{
+    for (auto fd : _fds)
+        close(fd);
+
+    _fds.clear();
+}
+
+std::vector<unsigned long long> Reader::read() const
+{
+    std::vector<unsigned long long> values;
+    values.reserve(_events.size());
+
+    /* { nr, values[nr] } per group */
+    std::vector<uint64_t> buf(_events.size() + 1);
+
+    for (auto leader : _leaders) {
+        auto len = ::read(leader, buf.data(), buf.size() * sizeof(uint64_t));
+        if (len < static_cast<ssize_t>(sizeof(uint64_t)))
+            throw std::runtime_error{"Failed to read the RAPL perf events!"};
+
+        values.insert(values.end(), buf.begin() + 1, buf.begin() + 1 + buf[0]);
+    }
+
+    return values;
+}
+
+std::vector<Energy> Reader::to_energy(const std::vector<unsigned long long> &counts) const
+{
+    std::vector<Energy> energy(packages());
+
+    for (size_t i = 0; i < _events.size(); ++i) {
+        auto &event = _events[i];
+
+        /* The 64-bit mantissa of a long double holds every counter value exactly */
+        unsigned long long delta = static_cast<long double>(counts[i]) * event.scale + 0.5L;
+
+        switch (event.domain) {
+            case powercap::Zone::PKG:
+                energy[event.package].package += delta;
+                break;
+            case powercap::Zone::CORE:
+                energy[event.package].core += delta;
+                break;
+            case powercap::Zone::DRAM:
+                energy[event.package].dram += delta;
+                break;
+            case powercap::Zone::GPU:
+                energy[event.package].gpu += delta;
+                break;
+        }
+    }
+
+    return energy;
+}
+
+} /* namespace perf */
+
+
+const std::string PerfMeasure::name = {"perf"};
+
+PerfMeasure::PerfMeasure(Process *proc) :
+    Measure{proc}, _reader{perf::Reader::instance()}, _accum_counts(_reader.events()), _last{}
+{}
+
+void PerfMeasure::update()
+{
+    auto current = _reader.read();
+
+    /* The counters are 64 bits wide and hence don't wrap around */
+    for (size_t i = 0; i < current.size(); ++i)
+        _accum_counts[i] += current[i] - _last[i];
+
+    _last = std::move(current);
+}
+
+bool PerfMeasure::start_(const ProcessSnapshot &)
+{
+    _last = _reader.read();
+
+    return true;
+}
+
+bool PerfMeasure::stop_(const ProcessSnapshot &)
+{
+    update();
+
+    return true;
+}
+
+void PerfMeasure::reset_()
+{
+    for (auto &c : _accum_counts)
+        c = 0;
+
+    if (this->_running)
+        _last = _reader.read();
+}
+
+Energy PerfMeasure::energy(const ProcessSnapshot &snap)
+{
+    Energy sum{};
+
+    for (auto &e : packages(snap))
+        sum += e;
+
+    return sum;
+}
+
+std::vector<Energy> PerfMeasure::packages(const ProcessSnapshot &)
+{
+    if (this->_running)
+        update();
+
+    /* Only convert the raw values now to not accumulate rounding errors */
+    return _reader.to_energy(_accum_counts);
+}
+
+namespace attribution {
+
+Share &Share::operator+=(const Share &o)
+{
+    package += o.package;
+    core += o.core;
+    dram += o.dram;
+    gpu += o.gpu;
+
+    return *this;
+}
+
+Energy Share::energy() const
+{
+    Energy e{};
+
+    e.package = package + 0.5;
+    e.core = core + 0.5;
+    e.dram = dram + 0.5;
+    e.gpu = gpu + 0.5;
+
+    return e;
+}
+
+/**
+ * The energy consumed by the whole system, from the powercap zones or the
+ * MSRs -- whatever is available.
+ **/
+class Source
+{
+   private:
+    powercap::Reader *_powercap;
+    std::vector<unsigned long long> _last_powercap;
+
+    rapl::Tracker *_tracker;
+    rapl::Totals _last_rapl;
+
+   public:
+    Source();
+    Source(const Source&) = delete;
+
+    ~Source();
+
+    Source& operator=(const Source&) = delete;
+
+    /* The energy consumed since the last call */
+    Energy consumed();
+};
+
+Source::Source() :
+    _powercap{nullptr}, _last_powercap{}, _tracker{nullptr}, _last_rapl{}
+{
+    try {
+        _powercap = &powercap::Reader::instance();
+        _last_powercap = _powercap->read();
+        return;
+    } catch (std::runtime_error &) {
+        _powercap = nullptr;
+    }
+
+    _tracker = &rapl::Tracker::instance();
+    _tracker->acquire();
+    _last_rapl = _tracker->totals();
+}
+
+Source::~Source()
+{
+    if (_tracker)
+        _tracker->release();
+}
+
+Energy Source::consumed()
+{
+    Energy sum{};
+
+    if (_powercap) {
+        auto current = _powercap->read();
+        std::vector<Energy> pkgs(_powercap->packages());
+
+        _powercap->accumulate(_last_powercap, current, pkgs);
+        _last_powercap = std::move(current);
+
+        for (auto &e : pkgs)
+            sum += e;
+    } else {
+        auto current = _tracker->totals();
+
+        for (size_t i = 0; i < current.packages.size(); ++i)
+            sum += rapl::to_energy(rapl::consumed_ticks(_last_rapl.packages[i], current.packages[i]));
+
+        _last_rapl = std::move(current);
+    }
+
+    return sum;
+}
+
+
+const std::chrono::milliseconds Attributor::interval = std::chrono::milliseconds{100};
+
+Attributor &Attributor::instance()
+{
+    static Attributor attributor;
+
+    return attributor;
+}
+
+Attributor::Attributor() :
+    _mutex{}, _cond{}, _thread{}, _generation{0}, _schedstat{false}, _source{}, _last_busy{0},
+    _clients{}, _other{}, _used{false}
+{}
+
+Attributor::~Attributor()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    stop(lock);
+}
+
+/* The time all CPUs together spent running tasks (in ns) */
+unsigned long long Attributor::busy_time() const
+{
+    unsigned long long busy = 0;
+
+    if (_schedstat)
+        procfs::read_cpu_runtime(busy);
+    else if (procfs::read_cpu_busy(busy))
+        busy = busy * 1000000000ULL / procfs::clock_ticks();
+
+    return busy;
+}
+
+/* The on-CPU time of the client's process since the last call (in ns) */
+unsigned long long Attributor::cpu_time(Client &c) const
+{
+    /* The process' times include the threads that already exited and the
+     * children it waited for, but only in whole clock ticks. */
+    unsigned long long total = 0;
+    procfs::Stat st;
+
+    if (procfs::read_stat(c.pid, st))
+        total = (st.utime + st.stime + st.cutime + st.cstime) * 1000000000ULL / procfs::clock_ticks();
+
+    if (!_schedstat) {
+        unsigned long long delta = total > c.time ? total - c.time : 0;
+
+        c.time = std::max(c.time, total);
+        return delta;
+    }
+
+    /* The exact runtimes of the current threads, new ones count with their
+     * whole runtime. */
+    std::vector<pid_t> tids(16);
+    int count;
+
+    while ((count = eteam_threads(c.pid, tids.data(), tids.size())) > static_cast<int>(tids.size()))
+        tids.resize(count * 2);
+
+    std::map<pid_t, unsigned long long> runtimes;
+    unsigned long long live = 0;
+
+    for (int i = 0; i < count; ++i) {
+        unsigned long long runtime;
+
+        if (!procfs::read_task_runtime(c.pid, tids[i], runtime))
+            continue;
+
+        auto it = c.runtimes.find(tids[i]);
+        auto last = it == c.runtimes.end() ? 0 : it->second;
+
+        if (runtime > last)
+            live += runtime - last;
+
+        runtimes.emplace(tids[i], runtime);
+    }
+
+    c.runtimes = std::move(runtimes);
+
+    /* Both the exact sum and the process' times never exceed the real time,
+     * hence the process' times add what exited since the last interval (up
+     * to a clock tick) without the rounding adding up. */
+    auto time = std::max(c.time + live, total);
+    auto delta = time - c.time;
+
+    c.time = time;
+    return delta;
+}
+
+void Attributor::sample()
+{
+    if (!_source)
+        return;
+
+    auto energy = _source->consumed();
+
+    auto busy = busy_time();
+    unsigned long long total = busy > _last_busy ? busy - _last_busy : 0;
+    _last_busy = busy;
+
+    std::vector<unsigned long long> times;
+    unsigned long long measured = 0;
+
+    for (auto &c : _clients) {
+        times.push_back(cpu_time(c.second));
+        measured += times.back();
+    }
+
+    /* The two sources might be slightly out of sync */
+    total = std::max(total, measured);
+
+    auto attribute = [&energy](Share &share, double fraction) {
+        share.package += energy.package * fraction;
+        share.core += energy.core * fraction;
+        share.dram += energy.dram * fraction;
+        share.gpu += energy.gpu * fraction;
+    };
+
+    if (total == 0) {
+        attribute(_other, 1);
+        return;
+    }
+
+    size_t i = 0;
+    for (auto &c : _clients)
+        attribute(c.second.energy, static_cast<double>(times[i++]) / total);
+
+    attribute(_other, static_cast<double>(total - measured) / total);
+}
+
+void Attributor::run(unsigned int generation)
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+
+    while (!_cond.wait_for(lock, interval, [&] { return _generation != generation; })) {
+        try {
+            sample();
+        } catch (std::runtime_error &) {
+            /* Try again in the next interval */
+        }
+    }
+}
+
+void Attributor::stop(std::unique_lock<std::mutex> &lock)
+{
+    /* Tell the current thread to exit and wait for it without holding the
+     * lock, which it needs to notice. */
+    _generation++;
+
+    std::thread thread{std::move(_thread)};
+    auto source = std::move(_source);
+    lock.unlock();
+
+    _cond.notify_all();
+
+    if (thread.joinable())
+        thread.join();
+}
+
+void Attributor::add(const void *owner, pid_t pid)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    if (_clients.empty()) {
+        unsigned long long runtime;
+
+        _schedstat = procfs::read_cpu_runtime(runtime);
+        _source.reset(new Source{});
+        _last_busy = busy_time();
+        _used = true;
+
+        _thread = std::thread{&Attributor::run, this, _generation};
+    } else {
+        /* Everything until now belongs to the other processes */
+        sample();
+    }
+
+    Client c{pid, {}, 0, {}};
+    cpu_time(c);
+
+    _clients[owner] = c;
+}
+
+Share Attributor::remove(const void *owner)
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+
+    auto it = _clients.find(owner);
+    if (it == _clients.end())
+        return {};
+
+    sample();
+
+    auto share = it->second.energy;
+    _clients.erase(it);
+
+    if (_clients.empty())
+        stop(lock);
+
+    return share;
+}
+
+Share Attributor::energy(const void *owner)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    auto it = _clients.find(owner);
+    if (it == _clients.end())
+        return {};
+
+    sample();
+    return it->second.energy;
+}
+
+bool Attributor::used()
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    return _used;
+}
+
+Share Attributor::other()
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+
+    if (!_clients.empty())
+        sample();
+
+    return _other;
+}
+
+} /* namespace attribution */
+
+
+const std::string AttributionMeasure::name = {"attrib"};
+
+AttributionMeasure::AttributionMeasure(Process *proc) :
+    Measure{proc}, _attributor{attribution::Attributor::instance()}, _accum_energy{}
+{}
+
+AttributionMeasure::~AttributionMeasure()
+{
+    if (this->_running)
+        _attributor.remove(this);
+}
+
+bool AttributionMeasure::start_(const ProcessSnapshot &)
+{
+    _attributor.add(this, this->_proc->pid());
+
+    return true;
+}
+
+bool AttributionMeasure::stop_(const ProcessSnapshot &)
+{
+    _accum_energy += _attributor.remove(this);
+
+    return true;
+}
+
+void AttributionMeasure::reset_()
+{
+    _accum_energy = {};
+
+    /* Start over with a fresh share */
+    if (this->_running) {
+        _attributor.remove(this);
+        _attributor.add(this, this->_proc->pid());
+    }
+}
+
+Energy AttributionMeasure::energy(const ProcessSnapshot &)
+{
+    auto share = _accum_energy;
+
+    if (this->_running)
+        share += _attributor.energy(this);
+
+    return share.energy();
+}
+
+
+
+MultiMeasure::MultiMeasure(Process *proc, Aggregation agg, const std::vector<MeasureType> &types) :
+    Measure{proc, agg}, _measures{}
+{
+    for (auto type : types)
+        _measures.emplace_back(Measure::measure_with(type, proc, agg));
+}
+
+std::string MultiMeasure::repr() const
+{
+    std::string repr;
+
+    for (auto &m : _measures) {
+        if (!repr.empty())
+            repr += "/";
+
+        repr += m->repr();
+    }
+
+    return repr;
+}
+
+bool MultiMeasure::start_(const ProcessSnapshot &snap)
+{
+    /* Start all measurements with the same snapshot right after each other and
+     * stop them in the same order, so that all of them cover an interval of
+     * the same length. */
+    for (size_t i = 0; i < _measures.size(); ++i) {
+        bool started = false;
+        std::exception_ptr error;
+
+        try {
+            started = _measures[i]->start(snap);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        if (!started) {
+            /* Either all measurements run or none */
+            while (i-- > 0) {
+                try {
+                    _measures[i]->stop(snap);
+                } catch (...) {}
+            }
+
+            if (error)
+                std::rethrow_exception(error);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MultiMeasure::stop_(const ProcessSnapshot &snap)
+{
+    bool ok = true;
+    std::exception_ptr error;
+
+    /* Stop every measurement even if one of them fails. Those that failed keep
+     * running, stopping again only retries them as the others are stopped
+     * already. */
+    for (auto &m : _measures) {
+        try {
+            ok = m->stop(snap) && ok;
+        } catch (...) {
+            if (!error)
+                error = std::current_exception();
+
+            ok = false;
+        }
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+
+    return ok;
+}
+
+void MultiMeasure::reset_()
+{
+    for (auto &m : _measures)
+        m->reset();
+}
+
+Energy MultiMeasure::energy(const ProcessSnapshot &snap)
+{
+    return _measures.front()->energy(snap);
+}
+
+std::vector<Energy> MultiMeasure::packages(const ProcessSnapshot &snap)
+{
+    return _measures.front()->packages(snap);
+}
+
+std::vector<std::pair<std::string, Energy>> MultiMeasure::compared(const ProcessSnapshot &snap)
+{
+    std::vector<std::pair<std::string, Energy>> energies;
+
+    for (size_t i = 1; i < _measures.size(); ++i)
+        energies.emplace_back(_measures[i]->repr(), _measures[i]->energy(snap));
+
+    return energies;
+}
+
+void MultiMeasure::poll()
+{
+    for (auto &m : _measures)
+        m->poll();
 }
 
 } /* namespace detail */
@@ -1,29 +1,54 @@
 #ifndef __MEASURE_H__
 #define __MEASURE_H__
 
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "counters.h"
 #include "energy.h"
+#include "estimate.h"
 #include "time.h"
+#include "topology.h"
 
 
 class Process;
+struct ProcessSnapshot;
+struct eteam_tree;
 
 enum MeasureType {
     NONE,
     ETEAM,
-    MSR
+    MSR,
+    POWERCAP,
+    PERF,
+    ATTRIBUTION
+};
+
+/* Which tasks should be accounted to a process */
+enum Aggregation {
+    PROCESS,    /* only the process itself */
+    TREE        /* all threads of the process and all of its descendants */
 };
 
 class Measure
 {
    public:
-    static Measure* measure_with(MeasureType type, Process *proc);
-    static std::string measure_name(MeasureType);
+    static Measure* measure_with(MeasureType type, Process *proc, Aggregation agg=PROCESS);
+    static Measure* measure_with(const std::vector<MeasureType> &types, Process *proc, Aggregation agg=PROCESS);
+    static std::string measure_name(MeasureType type, Aggregation agg=PROCESS);
 
    protected:
     bool _running;
     Process *_proc;
+    Aggregation _aggregation;
 
    private:
     Time _last_proc_time;
@@ -31,26 +56,70 @@ class Measure
     double _measured;
     double _not_measured;
 
-    void update_times();
+    /* Hardware counters that run while the measurement is active */
+    bool _count;
+    bool _count_uncore;
+    std::unique_ptr<Counters> _counters;
+
+    /* The measured windows of a sampled process and the start of the current one */
+    bool _sample;
+    std::vector<Window> _windows;
+    Window _window;
+
+    void update_times(const ProcessSnapshot &snap);
+    Window window(const ProcessSnapshot &snap);
 
    private:
-    virtual bool start_() = 0;
-    virtual bool stop_() = 0;
+    virtual bool start_(const ProcessSnapshot &snap) = 0;
+    virtual bool stop_(const ProcessSnapshot &snap) = 0;
     virtual void reset_() = 0;
 
    public:
-    Measure(Process *proc);
+    Measure(Process *proc, Aggregation agg=PROCESS);
     virtual ~Measure() = default;
 
     virtual std::string repr() const = 0;
 
     bool start();
+    bool start(const ProcessSnapshot &snap);
     bool stop();
+    bool stop(const ProcessSnapshot &snap);
 
     void reset();
 
-    virtual Energy energy() = 0;
-    double rate();
+    /* Also count hardware events (and the memory traffic with uncore) */
+    void count(bool uncore);
+    bool counting() const;
+    CounterValues counters() const;
+
+    /* Open the counters while the process did not execute its program yet,
+     * they count from the exec on instead of from the start */
+    void open_counters();
+
+    /* Record the energy and CPU time of every window in which the process is measured */
+    void sample();
+
+    /* Called regularly while the process runs, for measurements that have to
+     * keep up with it (see ETeamMeasure) */
+    virtual void poll() {}
+
+    virtual Energy energy(const ProcessSnapshot &snap) = 0;
+    double rate(const ProcessSnapshot &snap);
+
+    /* The energy of the whole run extrapolated from the measured windows */
+    Estimate estimate(const ProcessSnapshot &snap);
+
+    /* The energy per CPU package, empty if the measurement can't distinguish them */
+    virtual std::vector<Energy> packages(const ProcessSnapshot &)
+    {
+        return {};
+    }
+
+    /* The energy of the further measurements which run side by side with this one */
+    virtual std::vector<std::pair<std::string, Energy>> compared(const ProcessSnapshot &)
+    {
+        return {};
+    }
 };
 
 namespace detail {
@@ -66,12 +135,12 @@ class NoMeasure : public Measure
 
     std::string repr() const { return name; }
 
-    bool start_() { return true; }
-    bool stop_() { return true; }
+    bool start_(const ProcessSnapshot &) { return true; }
+    bool stop_(const ProcessSnapshot &) { return true; }
 
     void reset_() {}
 
-    Energy energy() { return Energy{}; }
+    Energy energy(const ProcessSnapshot &) { return Energy{}; }
 };
 
 class ETeamMeasure : public Measure
@@ -79,21 +148,77 @@ class ETeamMeasure : public Measure
    public:
     static const std::string name;
 
+   private:
+    eteam_tree *_tree;
+
+    /* The descendants of the process for which E-Team was started as well */
+    std::set<pid_t> _started;
+
+    void start_descendants();
+    void stop_descendants();
+
    public:
-    ETeamMeasure(Process *proc);
+    ETeamMeasure(Process *proc, Aggregation agg);
+    ~ETeamMeasure();
 
-    std::string repr() const { return name; }
+    std::string repr() const { return Measure::measure_name(ETEAM, _aggregation); }
 
-    bool start_();
-    bool stop_();
+    bool start_(const ProcessSnapshot &snap);
+    bool stop_(const ProcessSnapshot &snap);
 
     void reset_();
 
-    Energy energy();
+    /**
+     * Read the process tree, so that the energy of the tasks which exit in
+     * between is not lost, and start E-Team for new descendants. The tree is
+     * only read at all when it is polled or its energy is queried.
+     **/
+    void poll();
+
+    Energy energy(const ProcessSnapshot &snap);
 };
 
 namespace rapl {
 
+/**
+ * Where to find a value in an MSR. Registers with nr 0 are not available.
+ **/
+struct Register
+{
+    unsigned int nr;
+    unsigned int shift;
+    unsigned long long mask;
+
+    constexpr bool available() const
+    {
+        return nr != 0;
+    }
+};
+
+/**
+ * The RAPL registers of a CPU vendor.
+ **/
+struct Descriptor
+{
+    const char *vendor;
+
+    Register unit;          /* energy status unit */
+    Register power_unit;
+    Register power_info;    /* thermal design power */
+
+    /* Energy status of the domains per package */
+    Register pkg;
+    Register core;
+    Register dram;
+    Register gpu;
+
+    /* Energy status per core */
+    Register core_energy;
+
+    /* The registers of the CPU we are running on (detected with cpuid) */
+    static const Descriptor &get();
+};
+
 struct Value {
    public:
     unsigned long pkg;
@@ -101,10 +226,136 @@ struct Value {
     unsigned long dram;
     unsigned long gpu;
 
-    static Value read();
+    static Value read(unsigned int cpu=0);
+
+    Value &operator+=(const Value &o);
+};
+
+/**
+ * The energy status units of the domains, i.e. one counter tick is 1/2^unit
+ * joules.
+ **/
+struct Units {
+    unsigned int pkg;
+    unsigned int core;
+    unsigned int dram;
+    unsigned int gpu;
+
+    static const Units &get();
 };
 
-Energy consumed_energy(const Value &start, const Value &end);
+/* Convert counter ticks exactly to uJ (rounded to the nearest value) */
+unsigned long long to_microjoules(unsigned long long ticks, unsigned int esu);
+
+/* The ticks between the two readings of the (32-bit) counters */
+Value consumed_ticks(const Value &start, const Value &end);
+
+/* Convert accumulated ticks to energy */
+Energy to_energy(const Value &ticks);
+
+/* The packages of the system (cached, at least one) */
+const std::vector<topology::Package> &packages();
+
+/* The index of the package with the given id in packages() */
+size_t package_index(unsigned int id);
+
+/* The cores of the system if they have their own energy counters (cached) */
+const std::vector<topology::Core> &cores();
+
+/**
+ * Counter values of all packages and cores (in the order of packages() and
+ * cores()).
+ **/
+struct Totals
+{
+    std::vector<Value> packages;
+    std::vector<unsigned long> cores;
+};
+
+/**
+ * Samples the RAPL counters of all packages in the background often enough to
+ * never miss a wrap around of the 32-bit registers, and accumulates them in
+ * 64-bit totals. The tracker is shared by all MSR measurements and only runs
+ * while at least one of them is active.
+ **/
+class Tracker
+{
+   private:
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::thread _thread;
+
+    int _users;
+    unsigned int _generation;   /* of the sampling thread */
+    std::chrono::milliseconds _period;
+
+    /* The last raw values and the totals (in raw units) */
+    Totals _last;
+    Totals _totals;
+
+    /* The time that the CPUs spent running tasks (per CPU, in ns) and when
+     * they were sampled the last time */
+    std::vector<unsigned long long> _runtimes;
+    std::chrono::steady_clock::time_point _sampled;
+
+    /**
+     * A process (together with its descendants) that gets a share of the per
+     * core counters, in proportion to the time its tasks ran on each core
+     * between two samples.
+     **/
+    struct Follower
+    {
+        pid_t pid;
+        std::map<pid_t, unsigned long long> runtimes;   /* of the tasks, in ns */
+        std::vector<unsigned long> ticks;               /* per package */
+    };
+
+    std::map<const void*, Follower> _followers;
+
+    static std::chrono::milliseconds period();
+
+    /* The time that all tasks ran on each core since the last sample (in ns) */
+    std::vector<unsigned long long> busy_cores();
+
+    /* The time that the tasks of the follower ran on each core since the last
+     * sample (in ns) */
+    std::vector<unsigned long long> used_cores(Follower &f);
+
+    void sample();
+    void run(unsigned int generation);
+    void stop(std::unique_lock<std::mutex> &lock);
+
+   public:
+    static Tracker &instance();
+
+    /* How often the cores of followed processes are sampled */
+    static const std::chrono::milliseconds interval;
+
+   public:
+    Tracker();
+    Tracker(const Tracker&) = delete;
+
+    ~Tracker();
+
+    Tracker& operator=(const Tracker&) = delete;
+
+    void acquire();
+    void release();
+
+    /* The current totals of all packages and cores, these never wrap around */
+    Totals totals();
+
+    /**
+     * Sample the per core counters often enough to follow the cores that the
+     * tasks of the process run on (only if there are per core counters). The
+     * owner must have acquired the tracker.
+     **/
+    void follow(const void *owner, pid_t pid);
+    void unfollow(const void *owner);
+
+    /* The core ticks per package (in the order of packages()) of the followed process */
+    std::vector<unsigned long> followed(const void *owner);
+};
 
 } /* namespace rapl */
 
@@ -114,20 +365,355 @@ class MSRMeasure : public Measure
     static const std::string name;
 
    private:
-    Energy _accum_energy;
-    rapl::Value _last_rapl;
+    rapl::Tracker &_tracker;
+
+    /* Per package, in the order of rapl::packages(), in raw ticks */
+    std::vector<rapl::Value> _accum_ticks;
+    rapl::Totals _last_rapl;
+
+    /* The core ticks per package that the tracker accounted to the process */
+    std::vector<unsigned long> _last_cores;
+
+    void update();
 
    public:
     MSRMeasure(Process *proc);
+    ~MSRMeasure();
+
+    std::string repr() const { return name; }
+
+    bool start_(const ProcessSnapshot &snap);
+    bool stop_(const ProcessSnapshot &snap);
+
+    void reset_();
+
+    Energy energy(const ProcessSnapshot &snap);
+    std::vector<Energy> packages(const ProcessSnapshot &snap);
+};
+
+namespace powercap {
+
+/* Default location of the powercap zones in sysfs */
+extern const std::string sysfs_root;
+
+/**
+ * A RAPL zone or subzone of the powercap framework.
+ **/
+struct Zone
+{
+    enum Domain {
+        PKG,
+        CORE,
+        DRAM,
+        GPU
+    };
+
+    unsigned int package;       /* index into the list of packages */
+    Domain domain;
+    int fd;                     /* of 'energy_uj' */
+    unsigned long long max;     /* 'max_energy_range_uj' */
+};
+
+/**
+ * Keeps the 'energy_uj' files of all RAPL zones below the given root (e.g.
+ * '<root>/intel-rapl:0' and '<root>/intel-rapl:0/intel-rapl:0:0') open, so
+ * that reading all of them only costs one pread per zone.
+ **/
+class Reader
+{
+   private:
+    std::vector<Zone> _zones;
+    size_t _packages;
+
+    void add_zone(const std::string &path, unsigned int package, Zone::Domain domain);
+
+   public:
+    static Reader &instance();
+
+   public:
+    Reader(const std::string &root=sysfs_root);
+    Reader(const Reader&) = delete;
+
+    ~Reader();
+
+    Reader& operator=(const Reader&) = delete;
+
+    size_t packages() const
+    {
+        return _packages;
+    }
+
+    /* Read the raw counters of all zones (in uJ) */
+    std::vector<unsigned long long> read() const;
+
+    /**
+     * Add the energy consumed between the two readings to the per package
+     * values. Only one wrap-around of a counter between the readings is
+     * handled, so they must not be further apart than the time it takes to
+     * consume the range of a zone (usually 262 kJ, more than 20 minutes at
+     * 200 W).
+     **/
+    void accumulate(const std::vector<unsigned long long> &start, const std::vector<unsigned long long> &end,
+            std::vector<Energy> &energy) const;
+};
+
+} /* namespace powercap */
+
+class PowercapMeasure : public Measure
+{
+   public:
+    static const std::string name;
+
+   private:
+    powercap::Reader &_reader;
+
+    /* Per package */
+    std::vector<Energy> _accum_energy;
+    std::vector<unsigned long long> _last;
+
+    void update();
+
+   public:
+    PowercapMeasure(Process *proc);
 
     std::string repr() const { return name; }
 
-    bool start_();
-    bool stop_();
+    bool start_(const ProcessSnapshot &snap);
+    bool stop_(const ProcessSnapshot &snap);
 
     void reset_();
 
-    Energy energy();
+    Energy energy(const ProcessSnapshot &snap);
+    std::vector<Energy> packages(const ProcessSnapshot &snap);
+};
+
+namespace perf {
+
+/* Default location of the RAPL perf PMU in sysfs */
+extern const std::string pmu_root;
+
+/**
+ * An energy event of the 'power' perf PMU.
+ **/
+struct Event
+{
+    unsigned int package;   /* index into the list of packages */
+    powercap::Zone::Domain domain;
+    long double scale;      /* counter value -> uJ */
+};
+
+/**
+ * One event group per package on the 'power' PMU. Every group returns the
+ * 64-bit counters of all of its domains with a single read.
+ **/
+class Reader
+{
+   private:
+    std::vector<int> _leaders;
+    std::vector<int> _fds;
+    std::vector<Event> _events;     /* in the order in which the groups return them */
+
+   public:
+    static Reader &instance();
+
+   public:
+    Reader(const std::string &root=pmu_root);
+    Reader(const Reader&) = delete;
+
+    ~Reader();
+
+    Reader& operator=(const Reader&) = delete;
+
+    size_t packages() const
+    {
+        return _leaders.size();
+    }
+
+    size_t events() const
+    {
+        return _events.size();
+    }
+
+    /* Read the raw counters of all events */
+    std::vector<unsigned long long> read() const;
+
+    /* Convert the (accumulated) counters of all events to the per package energy */
+    std::vector<Energy> to_energy(const std::vector<unsigned long long> &counts) const;
+};
+
+} /* namespace perf */
+
+class PerfMeasure : public Measure
+{
+   public:
+    static const std::string name;
+
+   private:
+    perf::Reader &_reader;
+
+    /* Per event, in raw counts */
+    std::vector<unsigned long long> _accum_counts;
+    std::vector<unsigned long long> _last;
+
+    void update();
+
+   public:
+    PerfMeasure(Process *proc);
+
+    std::string repr() const { return name; }
+
+    bool start_(const ProcessSnapshot &snap);
+    bool stop_(const ProcessSnapshot &snap);
+
+    void reset_();
+
+    Energy energy(const ProcessSnapshot &snap);
+    std::vector<Energy> packages(const ProcessSnapshot &snap);
+};
+
+namespace attribution {
+
+/**
+ * An amount of energy that is not rounded to whole uJ yet.
+ **/
+struct Share
+{
+    double package;
+    double core;
+    double dram;
+    double gpu;
+
+    Share &operator+=(const Share &o);
+
+    Energy energy() const;
+};
+
+class Source;
+
+/**
+ * Splits the energy of the whole system among the measured processes and an
+ * 'other' bucket in proportion to the CPU time that they used. The energy and
+ * the CPU times are sampled together in a fixed interval in the background.
+ * The on-CPU times come from the scheduler statistics (in ns) if the kernel
+ * provides them and from the process' user and system time otherwise. The
+ * latter also supplies the time of threads that exited between two samples
+ * and of the children the process waited for.
+ **/
+class Attributor
+{
+   public:
+    /* Length of the attribution intervals */
+    static const std::chrono::milliseconds interval;
+
+   private:
+    struct Client
+    {
+        pid_t pid;
+
+        /* The runtime of every thread seen in the last interval */
+        std::map<pid_t, unsigned long long> runtimes;
+
+        /* The on-CPU time attributed so far */
+        unsigned long long time;
+
+        Share energy;
+    };
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::thread _thread;
+
+    unsigned int _generation;   /* of the sampling thread */
+    bool _schedstat;
+
+    std::unique_ptr<Source> _source;
+    unsigned long long _last_busy;
+
+    std::map<const void *, Client> _clients;
+    Share _other;
+    bool _used;
+
+    unsigned long long busy_time() const;
+    unsigned long long cpu_time(Client &c) const;
+
+    void sample();
+    void run(unsigned int generation);
+    void stop(std::unique_lock<std::mutex> &lock);
+
+   public:
+    static Attributor &instance();
+
+   public:
+    Attributor();
+    Attributor(const Attributor&) = delete;
+
+    ~Attributor();
+
+    Attributor& operator=(const Attributor&) = delete;
+
+    /* Start/Stop to attribute energy to the process of the given owner */
+    void add(const void *owner, pid_t pid);
+    Share remove(const void *owner);
+
+    /* The energy attributed to the owner so far */
+    Share energy(const void *owner);
+
+    /* The energy of everything else during the time any process was measured */
+    bool used();
+    Share other();
+};
+
+} /* namespace attribution */
+
+class AttributionMeasure : public Measure
+{
+   public:
+    static const std::string name;
+
+   private:
+    attribution::Attributor &_attributor;
+    attribution::Share _accum_energy;
+
+   public:
+    AttributionMeasure(Process *proc);
+    ~AttributionMeasure();
+
+    std::string repr() const { return name; }
+
+    bool start_(const ProcessSnapshot &snap);
+    bool stop_(const ProcessSnapshot &snap);
+
+    void reset_();
+
+    Energy energy(const ProcessSnapshot &snap);
+};
+
+/**
+ * Runs several measurements of the same process at once, so that they can be
+ * compared without the noise between two separate runs. The first one is the
+ * primary measurement whose energy is reported, all others are available via
+ * compared().
+ **/
+class MultiMeasure : public Measure
+{
+   private:
+    std::vector<std::unique_ptr<Measure>> _measures;
+
+   public:
+    MultiMeasure(Process *proc, Aggregation agg, const std::vector<MeasureType> &types);
+
+    std::string repr() const;
+
+    bool start_(const ProcessSnapshot &snap);
+    bool stop_(const ProcessSnapshot &snap);
+
+    void reset_();
+
+    Energy energy(const ProcessSnapshot &snap);
+    std::vector<Energy> packages(const ProcessSnapshot &snap);
+    std::vector<std::pair<std::string, Energy>> compared(const ProcessSnapshot &snap);
+
+    void poll();
 };
 
 } /* namespace detail */
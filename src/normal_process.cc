@@ -1,28 +1,42 @@
 #include "normal_process.h"
 
-#include <fstream>
-#include <limits>
-#include <sstream>
+#include <cerrno>
+#include <functional>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <fcntl.h>
+#include <signal.h>
 #include <unistd.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 
 #include "execute.h"
 #include "measure.h"
+#include "procfs.h"
 #include "time.h"
 #include "energy.h"
 
 
 namespace detail {
 
-NormalProcess::NormalProcess(Executer *exec, MeasureType mt, const std::string &redirect) :
-    _pid{-1}, _measure{Measure::measure_with(mt, this)}, _exec{exec},
+/* P_PIDFD, which older C libraries do not know yet */
+static const idtype_t id_pidfd = static_cast<idtype_t>(3);
+
+NormalProcess::NormalProcess(Executer *exec, const std::vector<MeasureType> &types, Aggregation agg,
+        const std::string &redirect, int counters, bool sample,
+        const std::function<void(pid_t)> &prepare) :
+    _pid{-1}, _pidfd{-1}, _measure{Measure::measure_with(types, this, agg)}, _exec{exec},
     _out_redir{redirect}, _owned{true}
 {
-    start();
+    if (counters > 0)
+        _measure->count(counters > 1);
+
+    if (sample)
+        _measure->sample();
+
+    start(prepare);
 }
 
 NormalProcess::~NormalProcess()
@@ -34,29 +48,108 @@ NormalProcess::~NormalProcess()
         wait();
     }
 
+    if (_pidfd >= 0)
+        ::close(_pidfd);
+
     delete _measure;
     delete _exec;
 }
 
-void NormalProcess::start()
+void NormalProcess::start(const std::function<void(pid_t)> &prepare)
 {
     _start = Clock::now();
-    _pid = ::fork();
+
+    /* A child that has to be prepared waits before it executes the program.
+     * The counters are opened before the exec as well, so that they include
+     * the threads and children that the program creates right away. */
+    bool held = prepare || _measure->counting();
+
+    auto before_exec = [&](pid_t pid) {
+        if (prepare)
+            prepare(pid);
+
+        _measure->open_counters();
+    };
+
+    /* Programs are spawned without copying our address space, which is much
+     * faster for a large watcher, held ones with a clone that waits for us.
+     * Only functions need a fork. */
+    bool failed = false;
+
+    _pid = held ? _exec->spawn(_out_redir, before_exec) : _exec->spawn(_out_redir);
+
+    /* Only fall back to a fork if spawning itself is not possible. A program
+     * that could not be executed is not tried again, its child exits right
+     * away like one whose exec failed after a fork. */
+    bool spawned = _pid > 0;
+
+    if (_pid < 0)
+        failed = (errno != ENOSYS) && (errno != EINVAL);
+
+    int hold[2] = {-1, -1};
+
+    if (!spawned && held && ::pipe2(hold, O_CLOEXEC) < 0)
+        throw std::runtime_error{"Failed to create pipe"};
+
+    if (!spawned)
+        _pid = ::fork();
 
     if (_pid == 0) {
         /* Child */
 
+        /* Don't inherit the signals blocked by the watcher */
+        sigset_t mask;
+        sigemptyset(&mask);
+        ::sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+        if (held) {
+            char c;
+
+            /* Returns as soon as the parent closed its end */
+            ::close(hold[1]);
+            while (::read(hold[0], &c, 1) < 0 && errno == EINTR);
+            ::close(hold[0]);
+        }
+
         if (!_out_redir.empty()) {
-            auto redir = ::open(_out_redir.c_str(), O_WRONLY | O_APPEND | O_CREAT);
+            auto redir = ::open(_out_redir.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
             ::dup2(redir, 1);
             ::dup2(redir, 2);
             ::close(redir);
         }
 
-        ::exit(_exec->run());
+        /* Never return into the watcher from the child */
+        int ret = 127;
+
+        try {
+            if (!failed)
+                ret = _exec->run();
+        } catch (...) {}
+
+        ::exit(ret);
     } else if (_pid > 0){
+        /* The pid can't be reused before we reaped the child, so there is no
+         * race here. Even a child that already exited stays a zombie until
+         * then, and its pidfd is readable right away. Without pidfds (before
+         * Linux 5.3), the process' state is read from procfs instead. */
+        _pidfd = ::syscall(SYS_pidfd_open, _pid, 0);
+
+        if (held && !spawned) {
+            ::close(hold[0]);
+
+            before_exec(_pid);
+
+            /* Let the child continue */
+            ::close(hold[1]);
+        }
+
         _measure->start();
     } else {
+        if (held) {
+            ::close(hold[0]);
+            ::close(hold[1]);
+        }
+
         throw std::runtime_error{"Failed to fork"};
     }
 }
@@ -68,54 +161,60 @@ void NormalProcess::disown()
 
 int NormalProcess::wait()
 {
-    int status;
+    if (_pidfd >= 0) {
+        siginfo_t info{};
+
+        while (::waitid(id_pidfd, _pidfd, &info, WEXITED) < 0 && errno == EINTR);
+        ::close(_pidfd);
+        _pidfd = -1;
+
+        _pid = -1;
 
-    ::waitpid(_pid, &status, 0);
+        /* Like WEXITSTATUS, which is 0 if the child was killed by a signal */
+        return (info.si_code == CLD_EXITED) ? info.si_status : 0;
+    }
+
+    int status = 0;
+
+    while (::waitpid(_pid, &status, 0) < 0 && errno == EINTR);
     _pid = -1;
 
     return WEXITSTATUS(status);
 }
 
+static Process::State to_state(char st)
+{
+    switch(st) {
+        case Process::RUNNING:
+            return Process::RUNNING;
+        case Process::SLEEPING:
+            return Process::SLEEPING;
+        case Process::UNINTERRUPTIBLE:
+            return Process::UNINTERRUPTIBLE;
+        case Process::ZOMBIE:
+            return Process::ZOMBIE;
+        case Process::STOPPED:
+            return Process::STOPPED;
+        case Process::PAGING:
+            return Process::PAGING;
+        case Process::DEAD:
+            return Process::DEAD;
+        default:
+            return Process::UNKNOWN;
+    }
+}
+
 Process::State NormalProcess::state() const
 {
     if (_pid == -1)
         return INVALID;
 
-    std::stringstream path;
-    path << "/proc/" << _pid << "/stat";
-    std::ifstream stat{path.str(), std::ios::in};
-
-    if (stat.is_open()) {
-        /* Ignore the first two items in the 'stat' file. */
-        stat.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
-        stat.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
-
-        char st;
-        stat >> st;
-
-        stat.close();
-
-        switch(st) {
-            case RUNNING:
-                return RUNNING;
-            case SLEEPING:
-                return SLEEPING;
-            case UNINTERRUPTIBLE:
-                return UNINTERRUPTIBLE;
-            case ZOMBIE:
-                return ZOMBIE;
-            case STOPPED:
-                return STOPPED;
-            case PAGING:
-                return PAGING;
-            case DEAD:
-                return DEAD;
-            default:
-                return UNKNOWN;
-        }
-    } else {
+    procfs::Stat stat;
+
+    if (procfs::read_stat(_pid, stat))
+        return to_state(stat.state);
+    else
         return INVALID;
-    }
 }
 
 bool NormalProcess::valid() const
@@ -130,6 +229,19 @@ bool NormalProcess::running() const
 
 bool NormalProcess::finished() const
 {
+    if (_pidfd >= 0) {
+        siginfo_t info{};
+        int ret;
+
+        /* Check for the exit without reaping the child. Unlike the state in
+         * procfs, which is the one of the main thread, this is the exit of the
+         * whole process, and the same event that makes the pidfd readable. */
+        while ((ret = ::waitid(id_pidfd, _pidfd, &info, WEXITED | WNOHANG | WNOWAIT)) < 0 && errno == EINTR);
+
+        /* Fails only if the child is gone already */
+        return ret < 0 || info.si_pid != 0;
+    }
+
     auto st = state();
 
     return (st == ZOMBIE) || (st == DEAD);
@@ -162,61 +274,54 @@ pid_t NormalProcess::pid() const
     return _pid;
 }
 
-Energy NormalProcess::energy()
+int NormalProcess::pidfd() const
 {
-    return _measure->energy();
+    return _pidfd;
 }
 
-Time NormalProcess::time() const
+ProcessSnapshot NormalProcess::snapshot() const
 {
-    if (_pid == -1)
-        return Time{};
-
-    Time t{};
-
-    std::stringstream path;
-    path << "/proc/" << _pid << "/stat";
-    std::ifstream stat{path.str(), std::ios::in};
+    ProcessSnapshot snap{};
 
-    if (stat.is_open()) {
-        /* The values that we are interesting in are at position 14 and 15 */
-        for (int i = 1; i < 14; ++i)
-            stat.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
+    snap.timestamp = Clock::now();
 
-        stat >> t.user >> t.system;
-
-        stat.close();
-
-        t.user /= sysconf(_SC_CLK_TCK);
-        t.system /= sysconf(_SC_CLK_TCK);
+    if (_pid == -1) {
+        snap.state = INVALID;
+        return snap;
     }
 
-    path.str("");
-    path << "/proc/" << _pid << "/energystat";
-    std::ifstream estat{path.str(), std::ios::in};
-
-    if (estat.is_open()) {
-        /* The value that we are interested in is at position 7 */
-        for (int i = 1; i < 7; ++i)
-            estat.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
-
-        estat >> t.looped;
-
-        estat.close();
+    procfs::Stat stat;
+    if (procfs::read_stat(_pid, stat)) {
+        snap.state = to_state(stat.state);
+        snap.time.user = static_cast<double>(stat.utime) / procfs::clock_ticks();
+        snap.time.system = static_cast<double>(stat.stime) / procfs::clock_ticks();
+    } else {
+        snap.state = INVALID;
+    }
 
-        t.looped  /= 1000000.0; /* Convert micro seconds in seconds */
+    /* A main thread that exited before the other threads is a zombie already,
+     * the pidfd tells whether the process itself exited. */
+    if (_pidfd >= 0 && snap.valid()) {
+        if (finished())
+            snap.state = ZOMBIE;
+        else if (snap.finished())
+            snap.state = UNKNOWN;
     }
 
-    auto now = Clock::now();
+    procfs::EnergyStat estat;
+    if (procfs::read_energystat(_pid, estat)) {
+        snap.energy.package = estat.package;
+        snap.energy.core = estat.core;
+        snap.energy.dram = estat.dram;
+        snap.energy.gpu = estat.gpu;
+        snap.energy.loops = estat.loops;
 
-    t.wall = std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1,1>>>(now - _start).count();
+        snap.time.looped = estat.looped / 1000000.0; /* Convert micro seconds in seconds */
+    }
 
-    return t;
-}
+    snap.time.wall = std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1,1>>>(snap.timestamp - _start).count();
 
-double NormalProcess::rate()
-{
-    return _measure->rate();
+    return snap;
 }
 
 void NormalProcess::signal(int signum) const
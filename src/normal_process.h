@@ -2,8 +2,10 @@
 #define __NORMAL_PROCESS_H__
 
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <unistd.h>
 
@@ -19,7 +21,7 @@ class Program;
 
 namespace detail {
 
-using Clock = std::chrono::high_resolution_clock;
+using Clock = ProcessSnapshot::Clock;
 
 
 class NormalProcess : public Process
@@ -27,6 +29,7 @@ class NormalProcess : public Process
    public:
    private:
     pid_t _pid;
+    int _pidfd;
 
     Measure *_measure;
     Executer *_exec;
@@ -37,9 +40,12 @@ class NormalProcess : public Process
     bool _owned;
 
    private:
-    NormalProcess(Executer *exec, MeasureType mt, const std::string &redirect);
+    NormalProcess(Executer *exec, const std::vector<MeasureType> &types, Aggregation agg,
+            const std::string &redirect, int counters, bool sample,
+            const std::function<void(pid_t)> &prepare=nullptr);
 
-    void start();
+    /* With prepare, the child waits until it returned before it executes the program */
+    void start(const std::function<void(pid_t)> &prepare);
 
     friend class ::Program;
 
@@ -59,15 +65,14 @@ class NormalProcess : public Process
     std::string name() const;
     std::string type() const;
     pid_t pid() const;
+    int pidfd() const;
 
     Measure *measure()
     {
         return _measure;
     }
 
-    Energy energy();
-    Time time() const;
-    double rate();
+    ProcessSnapshot snapshot() const;
 
     void signal(int signum) const;
     void cont() const;
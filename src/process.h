@@ -1,6 +1,7 @@
 #ifndef __PROCESS_H__
 #define  __PROCESS_H__
 
+#include <chrono>
 #include <memory>
 #include <string>
 
@@ -11,6 +12,8 @@
 #include "time.h"
 
 
+struct ProcessSnapshot;
+
 class Process
 {
    public:
@@ -42,11 +45,12 @@ class Process
     virtual std::string type() const = 0;
     virtual pid_t pid() const = 0;
 
+    /* A pidfd of the process that becomes readable when it exits (-1 if there is none) */
+    virtual int pidfd() const = 0;
+
     virtual Measure *measure() = 0;
 
-    virtual Energy energy() = 0;
-    virtual Time time() const = 0;
-    virtual double rate() = 0;
+    virtual ProcessSnapshot snapshot() const = 0;
 
     virtual void signal(int signum) const = 0;
     virtual void cont() const = 0;
@@ -56,6 +60,32 @@ class Process
 };
 
 
+/**
+ * A consistent view of a process' state, CPU times and E-Team energy counters
+ * that was taken with a single read of the corresponding procfs files.
+ **/
+struct ProcessSnapshot
+{
+    using Clock = std::chrono::steady_clock;
+
+    Process::State state;
+    Time time;
+    Energy energy;
+
+    typename Clock::time_point timestamp;
+
+    bool valid() const
+    {
+        return state != Process::INVALID;
+    }
+
+    bool finished() const
+    {
+        return (state == Process::ZOMBIE) || (state == Process::DEAD);
+    }
+};
+
+
 using ProcessPtr = std::shared_ptr<Process>;
 
 #endif /* __PROCESS_H__ */
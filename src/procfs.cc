@@ -0,0 +1,389 @@
+#include "procfs.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace procfs {
+
+namespace {
+
+/* All files are considerably smaller than this (except for '/proc/schedstat'),
+ * and we anyways only need the first few fields of them. */
+constexpr size_t buf_size = 512;
+
+ssize_t read_path(const char *path, char *buf, size_t len)
+{
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    ssize_t n;
+    do {
+        n = ::read(fd, buf, len);
+    } while (n < 0 && errno == EINTR);
+
+    ::close(fd);
+
+    return n;
+}
+
+/* Call f(begin, end) for every chunk of the file while it returns true. */
+template <typename F>
+bool read_chunks(const char *path, F f)
+{
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    char buf[4096];
+    bool ok = true;
+
+    while (ok) {
+        auto n = ::read(fd, buf, sizeof(buf));
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0) {
+            ok = n == 0;
+            break;
+        }
+
+        ok = f(buf, buf + n);
+    }
+
+    ::close(fd);
+
+    return ok;
+}
+
+/* Call f(begin, end) for every line of the file while it returns true. The
+ * file is read in chunks into a fixed buffer, lines that do not fit are
+ * skipped. */
+template <typename F>
+bool read_lines(const char *path, F f)
+{
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    char buf[4096];
+    size_t len = 0;
+    bool skip = false, ok = true;
+
+    while (ok) {
+        auto n = ::read(fd, buf + len, sizeof(buf) - len);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0) {
+            if (n < 0)
+                ok = false;
+            else if (len > 0 && !skip)
+                ok = f(buf, buf + len);
+
+            break;
+        }
+
+        const char *begin = buf, *end = buf + len + n, *nl;
+        while (ok && (nl = static_cast<const char*>(std::memchr(begin, '\n', end - begin)))) {
+            if (!skip)
+                ok = f(begin, nl);
+
+            skip = false;
+            begin = nl + 1;
+        }
+
+        len = end - begin;
+        if (len == sizeof(buf)) {
+            skip = true;
+            len = 0;
+        } else {
+            std::memmove(buf, begin, len);
+        }
+    }
+
+    ::close(fd);
+
+    return ok;
+}
+
+ssize_t read_file(pid_t pid, const char *file, char *buf, size_t len)
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%d/%s", pid, file);
+
+    return read_path(path, buf, len);
+}
+
+class Scanner
+{
+   private:
+    const char *_cur;
+    const char *_end;
+
+    void skip_space()
+    {
+        while (_cur < _end && (*_cur == ' ' || *_cur == '\n'))
+            _cur++;
+    }
+
+   public:
+    Scanner(const char *begin, const char *end) :
+        _cur{begin}, _end{end}
+    {}
+
+    bool ok() const
+    {
+        return _cur != nullptr;
+    }
+
+    /* Continue scanning after the last occurrence of the character c. */
+    Scanner &after_last(char c)
+    {
+        if (!_cur)
+            return *this;
+
+        const char *p = _end;
+        while (p > _cur && *(p - 1) != c)
+            p--;
+
+        _cur = (p == _cur) ? nullptr : p;
+        return *this;
+    }
+
+    Scanner &skip(int fields = 1)
+    {
+        for (int i = 0; _cur && i < fields; ++i) {
+            skip_space();
+
+            if (_cur == _end) {
+                _cur = nullptr;
+                break;
+            }
+
+            while (_cur < _end && *_cur != ' ' && *_cur != '\n')
+                _cur++;
+        }
+
+        return *this;
+    }
+
+    Scanner &character(char &c)
+    {
+        if (!_cur)
+            return *this;
+
+        skip_space();
+
+        if (_cur == _end)
+            _cur = nullptr;
+        else
+            c = *_cur++;
+
+        return *this;
+    }
+
+    Scanner &number(unsigned long long &val)
+    {
+        if (!_cur)
+            return *this;
+
+        skip_space();
+
+        if (_cur == _end || *_cur < '0' || *_cur > '9') {
+            _cur = nullptr;
+            return *this;
+        }
+
+        unsigned long long v = 0;
+        while (_cur < _end && *_cur >= '0' && *_cur <= '9')
+            v = v * 10 + (*_cur++ - '0');
+
+        val = v;
+        return *this;
+    }
+};
+
+bool parse_stat(const char *buf, ssize_t len, Stat &st)
+{
+    if (len <= 0)
+        return false;
+
+    /* The command name (field 2) is put in parentheses and may itself contain
+     * spaces and parentheses, hence start after the last closing one. The
+     * state is field 3, user and system time are fields 14 and 15 (16 and 17
+     * for the children), and the processor is field 39. */
+    unsigned long long processor = 0;
+    Scanner s{buf, buf + len};
+    s.after_last(')').character(st.state).skip(10).number(st.utime).number(st.stime)
+        .number(st.cutime).number(st.cstime).skip(21).number(processor);
+
+    st.processor = processor;
+    return s.ok();
+}
+
+} /* namespace */
+
+bool read_stat(pid_t pid, Stat &st)
+{
+    char buf[buf_size];
+
+    return parse_stat(buf, read_file(pid, "stat", buf, buf_size), st);
+}
+
+bool read_task_stat(pid_t pid, pid_t tid, Stat &st)
+{
+    char path[64], buf[buf_size];
+    std::snprintf(path, sizeof(path), "/proc/%d/task/%d/stat", pid, tid);
+
+    return parse_stat(buf, read_path(path, buf, buf_size), st);
+}
+
+bool read_energystat(pid_t pid, EnergyStat &est)
+{
+    char buf[buf_size];
+
+    auto len = read_file(pid, "energystat", buf, buf_size);
+    if (len <= 0)
+        return false;
+
+    Scanner s{buf, buf + len};
+    s.number(est.package).number(est.dram).number(est.core).number(est.gpu)
+        .number(est.loops).skip().number(est.looped);
+
+    return s.ok();
+}
+
+bool read_task_runtime(pid_t pid, pid_t tid, unsigned long long &runtime)
+{
+    char path[64], buf[buf_size];
+    std::snprintf(path, sizeof(path), "/proc/%d/task/%d/schedstat", pid, tid);
+
+    auto len = read_path(path, buf, buf_size);
+    if (len <= 0)
+        return false;
+
+    Scanner s{buf, buf + len};
+    s.number(runtime);
+
+    return s.ok();
+}
+
+bool read_cpu_runtime(unsigned long long &runtime)
+{
+    std::vector<unsigned long long> runtimes;
+
+    if (!read_cpu_runtimes(runtimes))
+        return false;
+
+    runtime = 0;
+    for (auto r : runtimes)
+        runtime += r;
+
+    return true;
+}
+
+bool read_cpu_runtimes(std::vector<unsigned long long> &runtimes)
+{
+    bool found = false;
+
+    runtimes.clear();
+
+    /* One line per CPU and scheduling domain -- this easily exceeds a page on
+     * large machines. */
+    bool ok = read_lines("/proc/schedstat", [&](const char *begin, const char *end) {
+        if (end - begin < 4 || std::memcmp(begin, "cpu", 3) != 0)
+            return true;
+
+        /* 'cpu<N>' followed by 9 fields, the 7th is the time spent running tasks */
+        unsigned long long cpu = 0, val = 0;
+        Scanner s{begin + 3, end};
+        s.number(cpu).skip(6).number(val);
+
+        if (!s.ok())
+            return false;
+
+        if (cpu >= runtimes.size())
+            runtimes.resize(cpu + 1);
+
+        runtimes[cpu] = val;
+        found = true;
+
+        return true;
+    });
+
+    return ok && found;
+}
+
+bool read_task_children(pid_t pid, pid_t tid, std::vector<pid_t> &children)
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%d/task/%d/children", pid, tid);
+
+    /* A single line with the pids separated by spaces, which may be split at
+     * the end of a chunk */
+    unsigned long long child = 0;
+    bool digits = false;
+
+    bool ok = read_chunks(path, [&](const char *begin, const char *end) {
+        for (auto p = begin; p < end; ++p) {
+            if (*p >= '0' && *p <= '9') {
+                child = child * 10 + (*p - '0');
+                digits = true;
+            } else if (*p == ' ' || *p == '\n') {
+                if (digits)
+                    children.push_back(child);
+
+                child = 0;
+                digits = false;
+            } else {
+                return false;
+            }
+        }
+
+        return true;
+    });
+
+    if (ok && digits)
+        children.push_back(child);
+
+    return ok;
+}
+
+bool read_cpu_busy(unsigned long long &busy)
+{
+    char buf[buf_size];
+
+    auto len = read_path("/proc/stat", buf, buf_size);
+    if (len <= 0)
+        return false;
+
+    /* cpu user nice system idle iowait irq softirq steal ... (guest time is
+     * already part of user) */
+    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+    Scanner s{buf, buf + len};
+    s.skip().number(user).number(nice).number(system).number(idle).number(iowait)
+        .number(irq).number(softirq).number(steal);
+
+    if (!s.ok())
+        return false;
+
+    busy = user + nice + system + irq + softirq + steal;
+    return true;
+}
+
+long clock_ticks()
+{
+    static const long ticks = ::sysconf(_SC_CLK_TCK);
+
+    return ticks;
+}
+
+} /* namespace procfs */
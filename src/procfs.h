@@ -0,0 +1,97 @@
+#ifndef __PROCFS_H__
+#define __PROCFS_H__
+
+#include <vector>
+
+#include <unistd.h>
+
+
+namespace procfs {
+
+/**
+ * The parts of '/proc/<pid>/stat' that we are interested in.
+ **/
+struct Stat
+{
+    char state;
+    unsigned long long utime;   /* in clock ticks */
+    unsigned long long stime;   /* in clock ticks */
+    unsigned long long cutime;  /* of the waited-for children, in clock ticks */
+    unsigned long long cstime;  /* of the waited-for children, in clock ticks */
+    unsigned int processor;     /* CPU the task last ran on */
+};
+
+/**
+ * The parts of '/proc/<pid>/energystat' that we are interested in.
+ **/
+struct EnergyStat
+{
+    unsigned long long package;
+    unsigned long long dram;
+    unsigned long long core;
+    unsigned long long gpu;
+    unsigned long long loops;
+    unsigned long long looped;  /* in micro seconds */
+};
+
+/**
+ * Read '/proc/<pid>/stat'. Returns false if the file could not be read or
+ * parsed.
+ **/
+bool read_stat(pid_t pid, Stat &st);
+
+/**
+ * Read '/proc/<pid>/task/<tid>/stat'. Returns false if the file could not be
+ * read or parsed.
+ **/
+bool read_task_stat(pid_t pid, pid_t tid, Stat &st);
+
+/**
+ * Read '/proc/<pid>/energystat'. Returns false if the file could not be read
+ * or parsed.
+ **/
+bool read_energystat(pid_t pid, EnergyStat &est);
+
+/**
+ * Read the time that the task has spent on a CPU so far (first field of
+ * '/proc/<pid>/task/<tid>/schedstat', in ns). Returns false if the file could
+ * not be read or parsed.
+ **/
+bool read_task_runtime(pid_t pid, pid_t tid, unsigned long long &runtime);
+
+/**
+ * Read the time that all CPUs together spent running tasks so far (sum of the
+ * CPU lines of '/proc/schedstat', in ns). Returns false if the file could not
+ * be read or parsed.
+ **/
+bool read_cpu_runtime(unsigned long long &runtime);
+
+/**
+ * Like read_cpu_runtime(), but per CPU, indexed by the CPU number (CPUs that
+ * are not listed are zero). Returns false if the file could not be read or
+ * parsed.
+ **/
+bool read_cpu_runtimes(std::vector<unsigned long long> &runtimes);
+
+/**
+ * Read the children of the task (all pids of '/proc/<pid>/task/<tid>/children',
+ * which are appended to the list). Returns false if the file could not be
+ * read or parsed.
+ **/
+bool read_task_children(pid_t pid, pid_t tid, std::vector<pid_t> &children);
+
+/**
+ * Read the time that all CPUs together were busy so far (first line of
+ * '/proc/stat' without idle and iowait, in clock ticks). Returns false if the
+ * file could not be read or parsed.
+ **/
+bool read_cpu_busy(unsigned long long &busy);
+
+/**
+ * The number of clock ticks per second (cached value of sysconf(_SC_CLK_TCK)).
+ **/
+long clock_ticks();
+
+} /* namespace procfs */
+
+#endif /* __PROCFS_H__ */
@@ -0,0 +1,449 @@
+#include <eteam.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "energystat.h"
+
+
+/* Number of different regions per thread (must be a power of two). */
+#define PROFILE_MAX_REGIONS 256
+
+/* Maximum nesting depth of regions. */
+#define PROFILE_MAX_DEPTH 64
+
+/* Statistics of one region in one thread. All fields are only written by the
+ * owning thread, and may be read concurrently by a report. */
+struct profile_region {
+    const char *name;           /* NULL for an empty slot */
+
+    unsigned long long calls;
+    struct energy incl;
+    struct energy excl;
+    unsigned long long cpu_incl;    /* in ns */
+    unsigned long long cpu_excl;    /* in ns */
+};
+
+struct profile_frame {
+    struct profile_region *region;  /* NULL if the region could not be recorded */
+
+    struct energy start;
+    struct energy children;
+    unsigned long long cpu_start;
+    unsigned long long cpu_children;
+};
+
+struct profile_thread {
+    struct profile_thread *next;
+
+    pid_t tid;
+    int fd;
+
+    unsigned depth;
+    unsigned overflow;      /* Regions entered beyond PROFILE_MAX_DEPTH */
+    struct profile_frame stack[PROFILE_MAX_DEPTH];
+
+    struct profile_region regions[PROFILE_MAX_REGIONS];
+};
+
+/* Flat copy of the statistics of one region used for the report */
+struct profile_entry {
+    pid_t tid;
+    struct profile_region region;
+};
+
+
+/* All threads that ever recorded a region. Threads are only added to the list
+ * and never removed, so that the statistics of exited threads are still part
+ * of the report. */
+static struct profile_thread *profile_threads = NULL;
+
+static __thread struct profile_thread *profile_current = NULL;
+
+static pthread_once_t profile_once = PTHREAD_ONCE_INIT;
+static pthread_key_t profile_key;
+
+static char *profile_path = NULL;
+static int profile_flags = 0;
+
+
+static void counter_add(unsigned long long *counter, unsigned long long val)
+{
+    /* There is only a single writer, but readers might look at the counter
+     * concurrently. */
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + val, __ATOMIC_RELAXED);
+}
+
+static unsigned long long counter_get(const unsigned long long *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static void energy_counter_add(struct energy *counter, const struct energy *val)
+{
+    counter_add(&counter->package, val->package);
+    counter_add(&counter->core, val->core);
+    counter_add(&counter->dram, val->dram);
+    counter_add(&counter->gpu, val->gpu);
+}
+
+static void energy_sub(struct energy *e, const struct energy *o)
+{
+    e->package -= o->package;
+    e->core -= o->core;
+    e->dram -= o->dram;
+    e->gpu -= o->gpu;
+}
+
+static void energy_add(struct energy *e, const struct energy *o)
+{
+    e->package += o->package;
+    e->core += o->core;
+    e->dram += o->dram;
+    e->gpu += o->gpu;
+}
+
+static unsigned long long thread_cpu_time(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+        return 0;
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void thread_energy(struct profile_thread *thread, struct energy *energy)
+{
+    /* Without E-Team we can still provide the CPU time of the regions. */
+    if (thread->fd < 0 || __eteam_energystat_read(thread->fd, energy) < 0)
+        memset(energy, 0, sizeof(*energy));
+}
+
+static void profile_thread_exit(void *arg)
+{
+    struct profile_thread *thread = (struct profile_thread *)arg;
+
+    if (thread->fd >= 0)
+        close(thread->fd);
+
+    thread->fd = -1;
+}
+
+static void profile_atfork_child(void)
+{
+    /* Start from scratch in the child -- the statistics of the parent's
+     * threads are still in the parent's report. */
+    profile_threads = NULL;
+    profile_current = NULL;
+}
+
+static void profile_init(void)
+{
+    pthread_key_create(&profile_key, profile_thread_exit);
+    pthread_atfork(NULL, NULL, profile_atfork_child);
+}
+
+static struct profile_thread *profile_thread_get(void)
+{
+    struct profile_thread *thread = profile_current;
+
+    if (thread)
+        return thread;
+
+    pthread_once(&profile_once, profile_init);
+
+    thread = (struct profile_thread *)calloc(1, sizeof(*thread));
+    if (!thread)
+        return NULL;
+
+    thread->tid = (pid_t)syscall(SYS_gettid);
+    thread->fd = __eteam_energystat_open_task(getpid(), thread->tid);
+
+    /* Publish the thread so that reports can find it */
+    thread->next = __atomic_load_n(&profile_threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&profile_threads, &thread->next, thread, 1,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+
+    pthread_setspecific(profile_key, thread);
+    profile_current = thread;
+
+    return thread;
+}
+
+static struct profile_region *profile_region_get(struct profile_thread *thread, const char *name)
+{
+    unsigned long h = 2166136261UL;
+    const char *c;
+    size_t i, n;
+
+    /* Hash the name itself (FNV-1a), so that the same name at different
+     * addresses always starts probing at the same slot and is never added
+     * twice. Names are short, so this is cheap. */
+    for (c = name; *c; ++c) {
+        h ^= (unsigned char)*c;
+        h *= 16777619UL;
+    }
+
+    for (i = h & (PROFILE_MAX_REGIONS - 1), n = 0; n < PROFILE_MAX_REGIONS;
+            i = (i + 1) & (PROFILE_MAX_REGIONS - 1), ++n) {
+        struct profile_region *region = &thread->regions[i];
+        const char *rname = region->name;
+
+        if (!rname) {
+            __atomic_store_n(&region->name, name, __ATOMIC_RELEASE);
+            return region;
+        }
+
+        if (rname == name || strcmp(rname, name) == 0)
+            return region;
+    }
+
+    return NULL;
+}
+
+static int profile_entry_cmp(const void *a, const void *b)
+{
+    const struct profile_entry *ea = (const struct profile_entry *)a;
+    const struct profile_entry *eb = (const struct profile_entry *)b;
+
+    if (ea->region.incl.package != eb->region.incl.package)
+        return ea->region.incl.package < eb->region.incl.package ? 1 : -1;
+    if (ea->region.cpu_incl != eb->region.cpu_incl)
+        return ea->region.cpu_incl < eb->region.cpu_incl ? 1 : -1;
+
+    return strcmp(ea->region.name, eb->region.name);
+}
+
+static void profile_atexit(void)
+{
+    if (profile_path)
+        eteam_profile_report(profile_path, profile_flags);
+}
+
+
+int eteam_region_enter(const char *name)
+{
+    struct profile_thread *thread;
+    struct profile_frame *frame;
+
+    if (!name) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    thread = profile_thread_get();
+    if (!thread)
+        return -1;
+
+    if (thread->depth == PROFILE_MAX_DEPTH) {
+        /* Not recorded, its values end up in the innermost recorded region.
+         * The matching eteam_region_exit() only consumes the overflow. */
+        thread->overflow++;
+        errno = ENOSPC;
+        return -1;
+    }
+
+    frame = &thread->stack[thread->depth++];
+
+    frame->region = profile_region_get(thread, name);
+    memset(&frame->children, 0, sizeof(frame->children));
+    frame->cpu_children = 0;
+
+    /* Read the counters last, so that the bookkeeping is not part of the region. */
+    frame->cpu_start = thread_cpu_time();
+    thread_energy(thread, &frame->start);
+
+    if (!frame->region) {
+        /* The frame is kept anyways so that the nesting stays balanced. */
+        errno = ENOSPC;
+        return -1;
+    }
+
+    return 0;
+}
+
+int eteam_region_exit(void)
+{
+    struct profile_thread *thread = profile_current;
+    struct profile_frame *frame;
+    struct profile_region *region;
+    struct energy incl, excl;
+    unsigned long long cpu_incl;
+
+    if (!thread || thread->depth == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* The region was entered beyond the maximum depth */
+    if (thread->overflow > 0) {
+        thread->overflow--;
+        return 0;
+    }
+
+    /* Read the counters first, so that the bookkeeping is not part of the region. */
+    thread_energy(thread, &incl);
+    cpu_incl = thread_cpu_time();
+
+    frame = &thread->stack[--thread->depth];
+
+    energy_sub(&incl, &frame->start);
+    cpu_incl -= frame->cpu_start;
+
+    excl = incl;
+    energy_sub(&excl, &frame->children);
+
+    /* The inclusive values of this region are part of the parent's children. */
+    if (thread->depth > 0) {
+        struct profile_frame *parent = &thread->stack[thread->depth - 1];
+
+        energy_add(&parent->children, &incl);
+        parent->cpu_children += cpu_incl;
+    }
+
+    region = frame->region;
+    if (!region)
+        return 0;
+
+    counter_add(&region->calls, 1);
+    energy_counter_add(&region->incl, &incl);
+    energy_counter_add(&region->excl, &excl);
+    counter_add(&region->cpu_incl, cpu_incl);
+    counter_add(&region->cpu_excl, cpu_incl - frame->cpu_children);
+
+    return 0;
+}
+
+int eteam_profile_start(const char *path, int flags)
+{
+    static int registered = 0;
+    char *p;
+
+    if (!path) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    p = strdup(path);
+    if (!p)
+        return -1;
+
+    free(profile_path);
+    profile_path = p;
+    profile_flags = flags;
+
+    if (!registered) {
+        if (atexit(profile_atexit) != 0)
+            return -1;
+
+        registered = 1;
+    }
+
+    return 0;
+}
+
+int eteam_profile_report(const char *path, int flags)
+{
+    struct profile_thread *thread;
+    struct profile_entry *entries;
+    size_t count = 0, size = 0, i;
+    FILE *out;
+
+    if (!path) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Merge the statistics of all threads into one flat list */
+    for (thread = __atomic_load_n(&profile_threads, __ATOMIC_ACQUIRE); thread; thread = thread->next) {
+        for (i = 0; i < PROFILE_MAX_REGIONS; ++i) {
+            if (__atomic_load_n(&thread->regions[i].name, __ATOMIC_ACQUIRE))
+                size++;
+        }
+    }
+
+    entries = (struct profile_entry *)calloc(size ? size : 1, sizeof(*entries));
+    if (!entries)
+        return -1;
+
+    for (thread = __atomic_load_n(&profile_threads, __ATOMIC_ACQUIRE); thread; thread = thread->next) {
+        for (i = 0; i < PROFILE_MAX_REGIONS && count < size; ++i) {
+            const struct profile_region *r = &thread->regions[i];
+            struct profile_region *c = &entries[count].region;
+
+            c->name = __atomic_load_n(&r->name, __ATOMIC_ACQUIRE);
+            if (!c->name)
+                continue;
+
+            entries[count].tid = thread->tid;
+
+            c->calls = counter_get(&r->calls);
+            c->incl.package = counter_get(&r->incl.package);
+            c->incl.core = counter_get(&r->incl.core);
+            c->incl.dram = counter_get(&r->incl.dram);
+            c->incl.gpu = counter_get(&r->incl.gpu);
+            c->excl.package = counter_get(&r->excl.package);
+            c->excl.core = counter_get(&r->excl.core);
+            c->excl.dram = counter_get(&r->excl.dram);
+            c->excl.gpu = counter_get(&r->excl.gpu);
+            c->cpu_incl = counter_get(&r->cpu_incl);
+            c->cpu_excl = counter_get(&r->cpu_excl);
+
+            count++;
+        }
+    }
+
+    qsort(entries, count, sizeof(*entries), profile_entry_cmp);
+
+    if (strcmp(path, "-") == 0) {
+        out = stderr;
+    } else {
+        out = fopen(path, "w");
+        if (!out) {
+            free(entries);
+            return -1;
+        }
+    }
+
+    if (flags & ETEAM_PROFILE_CSV) {
+        fprintf(out, "tid,region,calls,pkg_incl,pkg_excl,core_incl,core_excl,dram_incl,dram_excl,"
+                "gpu_incl,gpu_excl,cpu_incl,cpu_excl\n");
+
+        for (i = 0; i < count; ++i) {
+            const struct profile_region *r = &entries[i].region;
+
+            fprintf(out, "%d,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+                    entries[i].tid, r->name, r->calls, r->incl.package, r->excl.package,
+                    r->incl.core, r->excl.core, r->incl.dram, r->excl.dram,
+                    r->incl.gpu, r->excl.gpu, r->cpu_incl, r->cpu_excl);
+        }
+    } else {
+        fprintf(out, "%-8s %-24s %10s %14s %14s %12s %12s\n", "tid", "region", "calls",
+                "pkg incl (uJ)", "pkg excl (uJ)", "cpu incl (ms)", "cpu excl (ms)");
+
+        for (i = 0; i < count; ++i) {
+            const struct profile_region *r = &entries[i].region;
+
+            fprintf(out, "%-8d %-24s %10llu %14llu %14llu %12.3f %12.3f\n", entries[i].tid,
+                    r->name, r->calls, r->incl.package, r->excl.package,
+                    r->cpu_incl / 1000000.0, r->cpu_excl / 1000000.0);
+        }
+    }
+
+    if (out != stderr)
+        fclose(out);
+    else
+        fflush(out);
+
+    free(entries);
+
+    return 0;
+}
@@ -3,24 +3,28 @@
 #include "normal_process.h"
 
 
-Program::Program(Executer *exec, MeasureType mt, const std::string &redirect) :
-    _exec(exec), _mt(mt), _redirect(redirect)
+Program::Program(Executer *exec, MeasureType mt, Aggregation agg, const std::string &redirect) :
+    _exec(exec), _mt(mt), _agg(agg), _redirect(redirect), _compare(), _counters(0), _sample(false)
 {}
 
-Program::Program(int argc, char *argv[], int start_arg, MeasureType mt, const std::string &redirect) :
-    Program(new detail::ExecExecuter(argc, argv, start_arg), mt, redirect)
+Program::Program(int argc, char *argv[], int start_arg, MeasureType mt, Aggregation agg,
+        const std::string &redirect) :
+    Program(new detail::ExecExecuter(argc, argv, start_arg), mt, agg, redirect)
 {}
 
-Program::Program(const std::function<int(void)> &func, MeasureType mt, const std::string &redirect) :
-    Program(new detail::FunctionExecuter(func), mt, redirect)
+Program::Program(const std::function<int(void)> &func, MeasureType mt, Aggregation agg,
+        const std::string &redirect) :
+    Program(new detail::FunctionExecuter(func), mt, agg, redirect)
 {}
 
 Program::Program(const Program& other) :
-    _exec{other._exec->clone()}, _mt{other._mt}, _redirect{other._redirect}
+    _exec{other._exec->clone()}, _mt{other._mt}, _agg{other._agg}, _redirect{other._redirect},
+    _compare{other._compare}, _counters{other._counters}, _sample{other._sample}
 {}
 
 Program::Program(Program&& other) :
-    _exec{other._exec}, _mt{other._mt}, _redirect{std::move(other._redirect)}
+    _exec{other._exec}, _mt{other._mt}, _agg{other._agg}, _redirect{std::move(other._redirect)},
+    _compare{std::move(other._compare)}, _counters{other._counters}, _sample{other._sample}
 {
     other._exec = nullptr;
 }
@@ -38,7 +42,11 @@ Program& Program::operator=(const Program& other)
 
     _exec = other._exec->clone();
     _mt = other._mt;
+    _agg = other._agg;
     _redirect = other._redirect;
+    _compare = other._compare;
+    _counters = other._counters;
+    _sample = other._sample;
 
     return *this;
 }
@@ -50,16 +58,39 @@ Program& Program::operator=(Program&& other)
 
     _exec = other._exec;
     _mt = other._mt;
+    _agg = other._agg;
     _redirect = std::move(other._redirect);
+    _compare = std::move(other._compare);
+    _counters = other._counters;
+    _sample = other._sample;
 
     other._exec = nullptr;
 
     return *this;
 }
 
-ProcessPtr Program::run()
+void Program::compare(MeasureType mt)
 {
-    return ProcessPtr{new detail::NormalProcess(_exec->clone(), _mt, _redirect)};
+    _compare.push_back(mt);
+}
+
+void Program::count(bool uncore)
+{
+    _counters = uncore ? 2 : 1;
+}
+
+void Program::sample()
+{
+    _sample = true;
+}
+
+ProcessPtr Program::run(const std::function<void(pid_t)> &prepare)
+{
+    std::vector<MeasureType> types{_mt};
+    types.insert(types.end(), _compare.begin(), _compare.end());
+
+    return ProcessPtr{new detail::NormalProcess(_exec->clone(), types, _agg, _redirect, _counters,
+                _sample, prepare)};
 }
 
 std::string Program::name() const
@@ -69,5 +100,15 @@ std::string Program::name() const
 
 std::string Program::type() const
 {
-    return Measure::measure_name(_mt);
+    std::string type = Measure::measure_name(_mt, _agg);
+
+    for (auto mt : _compare)
+        type += "/" + Measure::measure_name(mt, _agg);
+
+    return type;
+}
+
+Aggregation Program::aggregation() const
+{
+    return _agg;
 }
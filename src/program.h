@@ -3,6 +3,7 @@
 
 #include <string>
 #include <functional>
+#include <vector>
 
 #include "execute.h"
 #include "measure.h"
@@ -14,14 +15,26 @@ class Program
    private:
     Executer* _exec;
     MeasureType _mt;
+    Aggregation _agg;
     std::string _redirect;
 
+    /* Further measurement types which run side by side with _mt */
+    std::vector<MeasureType> _compare;
+
+    /* Hardware counters: 0 = none, 1 = core, 2 = core and uncore */
+    int _counters;
+
+    /* Record the measured windows to extrapolate the energy (see Measure::sample()) */
+    bool _sample;
+
    private:
-    Program(Executer *exec, MeasureType mt, const std::string &redirect="");
+    Program(Executer *exec, MeasureType mt, Aggregation agg, const std::string &redirect="");
 
    public:
-    Program(int argc, char *argv[], int start_arg, MeasureType mt, const std::string &redirect="");
-    Program(const std::function<int(void)> &func, MeasureType mt, const std::string &redirect="");
+    Program(int argc, char *argv[], int start_arg, MeasureType mt, Aggregation agg=PROCESS,
+            const std::string &redirect="");
+    Program(const std::function<int(void)> &func, MeasureType mt, Aggregation agg=PROCESS,
+            const std::string &redirect="");
 
     Program(const Program& other);
     Program(Program&& other);
@@ -31,10 +44,22 @@ class Program
     Program& operator=(const Program& other);
     Program& operator=(Program&& other);
 
-    ProcessPtr run();
+    /* Also measure with the given type at the same time (see Measure::compared()) */
+    void compare(MeasureType mt);
+
+    /* Count hardware events in every run (see Measure::count()) */
+    void count(bool uncore);
+
+    /* The process is only measured in sampling windows */
+    void sample();
+
+    /* Start a new run, prepare is called with its pid before the program is executed */
+    ProcessPtr run(const std::function<void(pid_t)> &prepare=nullptr);
 
     std::string name() const;
     std::string type() const;
+
+    Aggregation aggregation() const;
 };
 
 #endif /* __PROGRAM_H__ */
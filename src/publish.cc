@@ -0,0 +1,175 @@
+#include "publish.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include <eteam.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+
+#include "shm.h"
+
+
+static unsigned long long monotonic_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+Publisher::Publisher(int interval) :
+    _shm{nullptr}, _interval{interval}, _sfd{-1}, _pids{}, _slots{}, _energies{}, _errors{}
+{
+    int fd = shm_open(ETEAM_SHM_NAME, O_RDWR | O_CREAT | O_CLOEXEC, 0660);
+    if (fd < 0)
+        throw std::runtime_error{"Failed to open the shared memory segment!"};
+
+    /* Anybody with write access could take all slots or overwrite the values,
+     * so never use a segment that someone else created. */
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || st.st_uid != geteuid()) {
+        close(fd);
+        throw std::runtime_error{"The shared memory segment belongs to another user!"};
+    }
+
+    /* Processes of the same user and group can register themselves,
+     * independent of the umask. */
+    fchmod(fd, 0660);
+
+    if (ftruncate(fd, sizeof(eteam_shm)) < 0) {
+        close(fd);
+        throw std::runtime_error{"Failed to resize the shared memory segment!"};
+    }
+
+    void *mem = mmap(nullptr, sizeof(eteam_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mem == MAP_FAILED)
+        throw std::runtime_error{"Failed to map the shared memory segment!"};
+
+    _shm = static_cast<eteam_shm *>(mem);
+
+    /* Keep the registrations of a previous publisher if the layout matches. */
+    if (_shm->magic != ETEAM_SHM_MAGIC || _shm->version != ETEAM_SHM_VERSION) {
+        __atomic_store_n(&_shm->magic, 0, __ATOMIC_RELAXED);
+
+        for (auto &slot : _shm->slots)
+            slot = eteam_shm_slot{};
+
+        _shm->version = ETEAM_SHM_VERSION;
+        __atomic_store_n(&_shm->magic, ETEAM_SHM_MAGIC, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&_shm->interval, static_cast<unsigned long long>(_interval) * 1000000ULL,
+            __ATOMIC_RELAXED);
+
+    /* Stop publishing on SIGINT and SIGTERM */
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+
+    _sfd = signalfd(-1, &signals, SFD_CLOEXEC);
+    if (_sfd < 0)
+        throw std::runtime_error{"Failed to initialize signal FD!"};
+}
+
+Publisher::~Publisher()
+{
+    if (_sfd >= 0)
+        close(_sfd);
+
+    if (_shm) {
+        /* Tell the readers that the segment is gone, so that they switch to
+         * the one of the next publisher. */
+        __atomic_store_n(&_shm->magic, 0, __ATOMIC_RELEASE);
+
+        munmap(_shm, sizeof(eteam_shm));
+        shm_unlink(ETEAM_SHM_NAME);
+    }
+}
+
+void Publisher::publish()
+{
+    _pids.clear();
+    _slots.clear();
+
+    for (auto &slot : _shm->slots) {
+        pid_t pid = __atomic_load_n(&slot.pid, __ATOMIC_ACQUIRE);
+
+        if (pid == ETEAM_SHM_FREE || pid == ETEAM_SHM_DELETED)
+            continue;
+
+        _pids.push_back(pid);
+        _slots.push_back(&slot);
+    }
+
+    _energies.resize(_pids.size());
+    _errors.resize(_pids.size());
+
+    /* Sample all processes at once */
+    consumed_energy_many(_pids.data(), _pids.size(), _energies.data(), _errors.data());
+
+    auto now = monotonic_ns();
+
+    for (size_t i = 0; i < _slots.size(); ++i) {
+        auto slot = _slots[i];
+        bool gone = _errors[i] != 0 && slot->error != 0;
+
+        /* Writer side of the sequence lock */
+        unsigned seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        __atomic_store_n(&slot->energy.package, _energies[i].package, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->energy.core, _energies[i].core, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->energy.dram, _energies[i].dram, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->energy.gpu, _energies[i].gpu, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->timestamp, gone ? 0 : now, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->error, gone ? 0 : _errors[i], __ATOMIC_RELAXED);
+
+        __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+
+        /* Release the slots of processes that failed twice in a row -- they
+         * most probably exited. Readers got to see the error once. */
+        if (gone) {
+            pid_t pid = _pids[i];
+            __atomic_compare_exchange_n(&slot->pid, &pid, ETEAM_SHM_DELETED, false,
+                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void Publisher::loop()
+{
+    auto interval = std::chrono::milliseconds{_interval};
+    auto next = std::chrono::steady_clock::now();
+
+    while (true) {
+        publish();
+
+        next += interval;
+
+        auto now = std::chrono::steady_clock::now();
+        if (next < now)
+            next = now;
+
+        int timeout = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+
+        pollfd pfd{_sfd, POLLIN, 0};
+        if (poll(&pfd, 1, timeout) > 0)
+            break;
+    }
+}
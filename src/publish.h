@@ -0,0 +1,43 @@
+#ifndef __PUBLISH_H__
+#define __PUBLISH_H__
+
+#include <vector>
+
+#include <eteam.h>
+
+#include <unistd.h>
+
+#include "shm.h"
+
+
+/**
+ * Periodically samples the energy of all processes registered in the shared
+ * memory segment and publishes the values there (see consumed_energy_shm()).
+ **/
+class Publisher
+{
+   private:
+    eteam_shm *_shm;
+    int _interval;      /* in ms */
+    int _sfd;
+
+    std::vector<pid_t> _pids;
+    std::vector<eteam_shm_slot *> _slots;
+    std::vector<struct energy> _energies;
+    std::vector<int> _errors;
+
+   private:
+    void publish();
+
+   public:
+    Publisher(int interval);
+    Publisher(const Publisher&) = delete;
+
+    ~Publisher();
+
+    Publisher& operator=(const Publisher&) = delete;
+
+    void loop();
+};
+
+#endif /* __PUBLISH_H__ */
@@ -1,40 +1,80 @@
 #include "sampler.h"
 
-#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
 
 #include <unistd.h>
+#include <sys/timerfd.h>
 
+#include "measure.h"
 
-Sampler::Sampler(ProcessPtr process, double rate, int interval) :
-    _process{process}, _measure{0}, _not_measure{0}, _running{false}, _sampling{true},
-    _measuring{false}
+
+Sampler::Sampler(double rate, std::chrono::milliseconds interval) :
+    _process{}, _tfd{-1}, _measure{0}, _not_measure{0}, _random{std::random_device{}()},
+    _running{false}, _sampling{true}, _measuring{false}
 {
-    if (rate == 1.0) {
+    if (rate >= 1.0) {
         _sampling = false;
-    } else {
-        _measure = std::round(interval * rate);
-        _not_measure = std::round(interval * (1.0 - rate));
+        return;
     }
+
+    std::chrono::duration<double, std::micro> length = interval;
+
+    _measure = std::chrono::duration_cast<std::chrono::microseconds>(length * rate);
+    _not_measure = std::chrono::duration_cast<std::chrono::microseconds>(length * (1.0 - rate));
+
+    _tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (_tfd < 0)
+        throw std::runtime_error{"Failed to create the sampling timer!"};
+}
+
+Sampler::~Sampler()
+{
+    if (_tfd >= 0)
+        close(_tfd);
 }
 
-void Sampler::start()
+void Sampler::arm(std::chrono::microseconds mean)
+{
+    std::uniform_int_distribution<long> dist{mean.count() / 2, mean.count() * 3 / 2};
+    long usecs = std::max(dist(_random), 1L);
+
+    itimerspec its{};
+    its.it_value.tv_sec = usecs / 1000000;
+    its.it_value.tv_nsec = (usecs % 1000000) * 1000;
+
+    timerfd_settime(_tfd, 0, &its, nullptr);
+}
+
+void Sampler::start(ProcessPtr process)
 {
     if (_running)
         return;
 
+    _process = process;
+
     /* Remember that we are now started running */
     _running = true;
 
     /* When a program is started, it is always started with measuring enabled */
     _measuring = true;
 
-    /* If necessary set the alarm for the switch to not measuring */
+    /* If necessary set the timer for the switch to not measuring */
     if (_sampling)
-        alarm(_measure);
+        arm(_measure);
 }
 
 void Sampler::step()
 {
+    unsigned long long expirations;
+
+    /* Acknowledge the timer, even if we are already stopped */
+    if (_tfd < 0 || read(_tfd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return;
+
     if (!_sampling || !_running)
         return;
 
@@ -42,12 +82,12 @@ void Sampler::step()
         if (!_process->finished())
             _process->measure()->stop();
 
-        alarm(_not_measure);
+        arm(_not_measure);
     } else {
-        if (_process->finished())
+        if (!_process->finished())
             _process->measure()->start();
 
-        alarm(_measure);
+        arm(_measure);
     }
 
     _measuring = !_measuring;
@@ -58,6 +98,14 @@ void Sampler::stop()
     if (!_running)
         return;
 
+    /* Disarm the timer, so that the next run starts with a fresh window */
+    if (_sampling) {
+        itimerspec its{};
+        timerfd_settime(_tfd, 0, &its, nullptr);
+    }
+
+    _process.reset();
+
     /* Remember that we are not running anymore. */
     _running = false;
 }
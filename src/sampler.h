@@ -1,35 +1,53 @@
-#ifndef __SAMPLE_H__
-#define __SAMPLE_H__
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
 
-#include <string>
+#include <chrono>
+#include <random>
 
-#include "execute.h"
-#include "measure.h"
 #include "process.h"
 
 
-struct SamplerConf
-{
-    double rate;
-    int interval;
-};
-
+/**
+ * Switches the energy measurement of a process on and off, so that only the
+ * given fraction (rate) of its runtime is measured. The windows are timed with
+ * a timerfd, which has to be polled together with the other events of the
+ * caller and handed to step() whenever it is readable. Every window is drawn
+ * uniformly between half and one and a half times its mean length, so that
+ * the sampling does not alias with periodic workloads.
+ **/
 class Sampler
 {
    private:
     ProcessPtr _process;
+    int _tfd;
+
+    /* Mean length of the measuring and the not measuring windows */
+    std::chrono::microseconds _measure;
+    std::chrono::microseconds _not_measure;
 
-    int _measure;
-    int _not_measure;
+    std::mt19937 _random;
 
     bool _running;
     bool _sampling;
     bool _measuring;
 
+    void arm(std::chrono::microseconds mean);
+
    public:
-    Sampler(ProcessPtr process, double rate, int interval);
+    Sampler(double rate, std::chrono::milliseconds interval);
+    Sampler(const Sampler&) = delete;
+
+    ~Sampler();
+
+    Sampler& operator=(const Sampler&) = delete;
+
+    /* The timerfd which becomes readable at the end of every window */
+    int fd() const
+    {
+        return _tfd;
+    }
 
-    void start();
+    void start(ProcessPtr process);
     void step();
     void stop();
 };
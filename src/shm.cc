@@ -0,0 +1,268 @@
+#include <eteam.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm.h"
+
+
+/* Number of attempts to get a consistent read of a slot before giving up. */
+#define SHM_READ_RETRIES 1000
+
+/* A mapping of the segment together with the file it belongs to. */
+struct shm_mapping {
+    struct eteam_shm *shm;
+    dev_t dev;
+    ino_t ino;
+};
+
+/* Mappings are never unmapped once they are published here, since other
+ * threads might still read from them. A new one is only created if the
+ * publisher was restarted with a new segment. */
+static struct shm_mapping *shm_current = NULL;
+
+
+/* Map the segment, or return old if that is still the current one. */
+static struct shm_mapping *shm_map(struct shm_mapping *old)
+{
+    struct shm_mapping *mapping;
+    struct eteam_shm *shm;
+    struct stat st;
+    int fd;
+
+    /* The segment is created by the publisher. Don't remember failures, it
+     * might just not be running yet. */
+    fd = shm_open(ETEAM_SHM_NAME, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0)
+        return NULL;
+
+    /* The publisher creates the segment before it resizes it, accessing the
+     * pages beyond its end would raise SIGBUS. */
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(*shm)) {
+        close(fd);
+        errno = ENOENT;
+        return NULL;
+    }
+
+    if (old && st.st_dev == old->dev && st.st_ino == old->ino) {
+        close(fd);
+        return old;
+    }
+
+    shm = (struct eteam_shm *)mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (shm == MAP_FAILED)
+        return NULL;
+
+    /* The magic is written last when the publisher initializes the segment */
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != ETEAM_SHM_MAGIC ||
+            shm->version != ETEAM_SHM_VERSION) {
+        errno = shm->magic == 0 ? ENOENT : EPROTO;
+        munmap(shm, sizeof(*shm));
+        return NULL;
+    }
+
+    mapping = (struct shm_mapping *)malloc(sizeof(*mapping));
+    if (!mapping) {
+        munmap(shm, sizeof(*shm));
+        return NULL;
+    }
+
+    mapping->shm = shm;
+    mapping->dev = st.st_dev;
+    mapping->ino = st.st_ino;
+
+    return mapping;
+}
+
+/* Replace the mapping old (NULL if there is none yet) with a new one. Returns
+ * the current mapping, which is old if the segment did not change. */
+static struct shm_mapping *shm_attach(struct shm_mapping *old)
+{
+    struct shm_mapping *mapping, *expected;
+
+    mapping = shm_map(old);
+    if (!mapping || mapping == old)
+        return old;
+
+    /* Another thread might have been faster -- use its mapping instead. */
+    expected = old;
+    if (!__atomic_compare_exchange_n(&shm_current, &expected, mapping, 0,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        munmap(mapping->shm, sizeof(*mapping->shm));
+        free(mapping);
+        return expected;
+    }
+
+    return mapping;
+}
+
+static struct shm_mapping *shm_get(void)
+{
+    struct shm_mapping *mapping;
+
+    mapping = __atomic_load_n(&shm_current, __ATOMIC_ACQUIRE);
+    if (mapping)
+        return mapping;
+
+    return shm_attach(NULL);
+}
+
+static struct eteam_shm_slot *shm_find(struct eteam_shm *shm, pid_t pid, int create)
+{
+    struct eteam_shm_slot *free_slot = NULL;
+    unsigned i, n;
+
+    for (i = eteam_shm_hash(pid), n = 0; n < ETEAM_SHM_SLOTS; i = (i + 1) & (ETEAM_SHM_SLOTS - 1), ++n) {
+        struct eteam_shm_slot *slot = &shm->slots[i];
+        pid_t p = __atomic_load_n(&slot->pid, __ATOMIC_ACQUIRE);
+
+        if (p == pid)
+            return slot;
+
+        if (p == ETEAM_SHM_DELETED && !free_slot)
+            free_slot = slot;
+
+        if (p == ETEAM_SHM_FREE) {
+            if (!free_slot)
+                free_slot = slot;
+            break;
+        }
+    }
+
+    if (!create || !free_slot)
+        return NULL;
+
+    /* Register the pid -- the publisher will pick it up with its next round. */
+    for (i = free_slot - shm->slots, n = 0; n < ETEAM_SHM_SLOTS; i = (i + 1) & (ETEAM_SHM_SLOTS - 1), ++n) {
+        struct eteam_shm_slot *slot = &shm->slots[i];
+        pid_t p = __atomic_load_n(&slot->pid, __ATOMIC_ACQUIRE);
+
+        if (p == pid)
+            return slot;
+
+        if ((p == ETEAM_SHM_FREE || p == ETEAM_SHM_DELETED) &&
+                __atomic_compare_exchange_n(&slot->pid, &p, pid, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return slot;
+    }
+
+    return NULL;
+}
+
+static unsigned long long monotonic_ns(void)
+{
+    struct timespec ts;
+
+    /* This is handled by the vDSO and does not enter the kernel. */
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/* Read the latest value of a process from the given segment. */
+static int shm_read(struct eteam_shm *shm, pid_t pid, struct energy *energy, unsigned long long *age)
+{
+    struct eteam_shm_slot *slot;
+    struct energy e;
+    unsigned long long timestamp, now;
+    unsigned seq;
+    int error, i;
+
+    /* The publisher exited and removed the segment */
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != ETEAM_SHM_MAGIC) {
+        errno = ESTALE;
+        return -1;
+    }
+
+    slot = shm_find(shm, pid, 1);
+    if (!slot) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    for (i = 0; i < SHM_READ_RETRIES; ++i) {
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+
+        e.package = __atomic_load_n(&slot->energy.package, __ATOMIC_RELAXED);
+        e.core = __atomic_load_n(&slot->energy.core, __ATOMIC_RELAXED);
+        e.dram = __atomic_load_n(&slot->energy.dram, __ATOMIC_RELAXED);
+        e.gpu = __atomic_load_n(&slot->energy.gpu, __ATOMIC_RELAXED);
+        timestamp = __atomic_load_n(&slot->timestamp, __ATOMIC_RELAXED);
+        error = __atomic_load_n(&slot->error, __ATOMIC_RELAXED);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+            break;
+    }
+
+    if (i == SHM_READ_RETRIES || timestamp == 0) {
+        /* The publisher is busy with the slot, or did not sample the process yet. */
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (error) {
+        errno = error;
+        return -1;
+    }
+
+    now = monotonic_ns();
+
+    *energy = e;
+    if (age)
+        *age = now > timestamp ? now - timestamp : 0;
+
+    /* Allow some slack for the publisher to do its round. */
+    if (now > timestamp + 2 * __atomic_load_n(&shm->interval, __ATOMIC_RELAXED)) {
+        errno = ESTALE;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int consumed_energy_shm(pid_t pid, struct energy *energy, unsigned long long *age)
+{
+    struct shm_mapping *mapping, *current;
+
+    if (pid < 0 || !energy) {
+        errno = EINVAL;
+        return -1;
+    } else if (pid == 0) {
+        pid = getpid();
+    }
+
+    mapping = shm_get();
+    if (!mapping) {
+        if (errno != EPROTO && errno != EACCES)
+            errno = ENOENT;
+        return -1;
+    }
+
+    if (shm_read(mapping->shm, pid, energy, age) == 0)
+        return 0;
+    else if (errno != ESTALE)
+        return -1;
+
+    /* The publisher might have been restarted with a new segment, only then
+     * (and while it is not running) the fast path needs system calls. */
+    current = shm_attach(mapping);
+    if (current == mapping) {
+        errno = ESTALE;
+        return -1;
+    }
+
+    return shm_read(current->shm, pid, energy, age);
+}
@@ -0,0 +1,54 @@
+#ifndef __SHM_H__
+#define __SHM_H__
+
+#include <eteam.h>
+
+#include <unistd.h>
+
+
+/* Layout of the shared memory segment in which 'energy --publish' publishes the
+ * energy of all registered processes. */
+
+#define ETEAM_SHM_NAME "/eteam-energy"
+#define ETEAM_SHM_MAGIC 0x4554454dU     /* 'ETEM' */
+#define ETEAM_SHM_VERSION 1
+
+/* Number of slots (must be a power of two). */
+#define ETEAM_SHM_SLOTS 4096
+
+/* Special pid values of a slot */
+#define ETEAM_SHM_FREE 0
+#define ETEAM_SHM_DELETED -1
+
+/**
+ * The published values of a single process. The slot is protected by a
+ * sequence lock: the publisher makes seq odd while it updates the values,
+ * readers retry if seq was odd or changed while they read.
+ **/
+struct eteam_shm_slot {
+    unsigned seq;
+    pid_t pid;                      /* ETEAM_SHM_FREE, ETEAM_SHM_DELETED or the pid */
+
+    struct energy energy;
+    unsigned long long timestamp;   /* CLOCK_MONOTONIC of the sample in ns (0 if none yet) */
+    int error;                      /* errno of the last sample or 0 */
+};
+
+struct eteam_shm {
+    unsigned magic;
+    unsigned version;
+
+    unsigned long long interval;    /* publish interval in ns */
+
+    struct eteam_shm_slot slots[ETEAM_SHM_SLOTS];
+};
+
+/**
+ * The slot where the probe sequence for the given pid starts.
+ **/
+static inline unsigned eteam_shm_hash(pid_t pid)
+{
+    return ((unsigned)pid * 2654435761U) & (ETEAM_SHM_SLOTS - 1);
+}
+
+#endif /* __SHM_H__ */
@@ -0,0 +1,253 @@
+#include "threads.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <eteam.h>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/perf_event.h>
+
+#include "energy.h"
+
+
+static std::string thread_name(pid_t pid, pid_t tid)
+{
+    std::stringstream path;
+    path << "/proc/" << pid << "/task/" << tid << "/comm";
+
+    std::ifstream comm{path.str(), std::ios::in};
+    std::string name;
+
+    if (comm.is_open())
+        std::getline(comm, name);
+
+    return name;
+}
+
+/* Data pages of every ring buffer, must be a power of two */
+static const size_t buffer_pages = 8;
+
+static size_t page_size()
+{
+    static const size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+/* PERF_RECORD_FORK and PERF_RECORD_EXIT */
+struct TaskRecord
+{
+    perf_event_header header;
+    uint32_t pid, ppid;
+    uint32_t tid, ptid;
+    uint64_t time;
+};
+
+/* PERF_RECORD_COMM */
+struct CommRecord
+{
+    perf_event_header header;
+    uint32_t pid, tid;
+    char comm[];
+};
+
+ThreadTracker::ThreadTracker(pid_t pid) :
+    _pid{pid}, _name{thread_name(pid, pid)}, _threads{}, _reused{}, _tids(16), _fds{}, _buffers{},
+    _record{}
+{
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_SW_DUMMY;
+    attr.task = 1;
+    attr.comm = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.wakeup_events = 1;
+
+    /* Inherited events can only be mapped per CPU */
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+    for (long cpu = 0; cpu < cpus; ++cpu) {
+        int fd = syscall(SYS_perf_event_open, &attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+        if (fd < 0)
+            continue;   /* offline CPU or no perf at all */
+
+        void *buffer = mmap(nullptr, (buffer_pages + 1) * page_size(), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+
+        if (buffer == MAP_FAILED) {
+            close(fd);
+            continue;
+        }
+
+        _fds.push_back(fd);
+        _buffers.push_back(buffer);
+    }
+}
+
+ThreadTracker::~ThreadTracker()
+{
+    for (size_t i = 0; i < _fds.size(); ++i) {
+        munmap(_buffers[i], (buffer_pages + 1) * page_size());
+        close(_fds[i]);
+    }
+}
+
+const std::vector<int> &ThreadTracker::fds() const
+{
+    return _fds;
+}
+
+void ThreadTracker::sample(pid_t tid, bool created)
+{
+    struct energy e;
+
+    bool valid = consumed_energy_thread(_pid, tid, &e) == 0;
+
+    if (!valid && !created)
+        return;
+
+    Energy energy{};
+    if (valid)
+        energy = Energy{e.package, e.core, e.dram, e.gpu, 0};
+
+    /* New threads have the name of the process until they set their own,
+     * which perf reports with a comm record. */
+    auto name = [this, tid, created]() {
+        return created ? _name : thread_name(_pid, tid);
+    };
+
+    auto it = _threads.find(tid);
+    if (it == _threads.end()) {
+        _threads.emplace(tid, ThreadStats{tid, name(), energy});
+    } else if (energy.package < it->second.energy.package) {
+        /* A new thread reused the id of one that exited in the meantime. */
+        _reused.push_back(it->second);
+        it->second = ThreadStats{tid, name(), energy};
+    } else {
+        it->second.energy = energy;
+    }
+}
+
+void ThreadTracker::scan()
+{
+    int count;
+
+    /* Make sure that we get all threads even if the process just spawned a
+     * lot of new ones. */
+    while ((count = eteam_threads(_pid, _tids.data(), _tids.size())) > static_cast<int>(_tids.size()))
+        _tids.resize(count * 2);
+
+    if (count < 0)
+        return;
+
+    for (int i = 0; i < count; ++i)
+        sample(_tids[i]);
+}
+
+void ThreadTracker::handle(const void *record)
+{
+    auto header = static_cast<const perf_event_header*>(record);
+
+    switch (header->type) {
+        case PERF_RECORD_FORK:
+        case PERF_RECORD_EXIT: {
+            /* New processes have their own pid, only threads are of interest */
+            auto task = static_cast<const TaskRecord*>(record);
+
+            if (static_cast<pid_t>(task->pid) == _pid)
+                sample(task->tid, header->type == PERF_RECORD_FORK);
+            break;
+        }
+        case PERF_RECORD_COMM: {
+            auto comm = static_cast<const CommRecord*>(record);
+
+            if (static_cast<pid_t>(comm->pid) != _pid)
+                break;
+
+            size_t len = header->size - sizeof(CommRecord);
+            std::string name{comm->comm, strnlen(comm->comm, len)};
+
+            /* The main thread is renamed on exec */
+            if (static_cast<pid_t>(comm->tid) == _pid)
+                _name = name;
+
+            auto it = _threads.find(comm->tid);
+            if (it != _threads.end())
+                it->second.name = name;
+            break;
+        }
+        case PERF_RECORD_LOST:
+            /* The buffer overflowed, at least find the threads that are still there */
+            scan();
+            break;
+    }
+}
+
+void ThreadTracker::events()
+{
+    const uint64_t size = buffer_pages * page_size();
+
+    for (auto buffer : _buffers) {
+        auto meta = static_cast<perf_event_mmap_page*>(buffer);
+        auto data = static_cast<const char*>(buffer) + page_size();
+
+        uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+        uint64_t tail = meta->data_tail;
+
+        /* Records are 8 byte aligned, so only their body can wrap around */
+        while (tail < head) {
+            auto offset = tail % size;
+            const void *record = data + offset;
+            size_t len = static_cast<const perf_event_header*>(record)->size;
+
+            if (offset + len > size) {
+                _record.resize((len + 7) / 8);
+
+                auto copy = reinterpret_cast<char*>(_record.data());
+                std::memcpy(copy, data + offset, size - offset);
+                std::memcpy(copy + size - offset, data, len - (size - offset));
+
+                record = copy;
+            }
+
+            handle(record);
+            tail += len;
+        }
+
+        __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+void ThreadTracker::update()
+{
+    events();
+    scan();
+}
+
+std::vector<ThreadStats> ThreadTracker::top(size_t n) const
+{
+    std::vector<ThreadStats> all{_reused};
+
+    for (auto &t : _threads)
+        all.push_back(t.second);
+
+    std::sort(all.begin(), all.end(), [](const ThreadStats &a, const ThreadStats &b) {
+            return a.energy.package > b.energy.package;
+        });
+
+    if (all.size() > n)
+        all.resize(n);
+
+    return all;
+}
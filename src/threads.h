@@ -0,0 +1,74 @@
+#ifndef __THREADS_H__
+#define __THREADS_H__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "energy.h"
+
+
+struct ThreadStats
+{
+    pid_t tid;
+    std::string name;
+    Energy energy;
+};
+
+/**
+ * Keeps track of the energy consumption of all threads of a process. Threads
+ * are discovered every time the tracker is updated, and threads that exit
+ * keep the energy values of their last update.
+ *
+ * Additionally, the tracker follows the fork and exit notifications of perf
+ * (a dummy software event with task events on every CPU). A thread is then
+ * recorded as soon as it is created, even if it exits before the next update,
+ * and its energy is read once more when it exits. Without perf, threads are
+ * only discovered on updates.
+ **/
+class ThreadTracker
+{
+   private:
+    pid_t _pid;
+    std::string _name;
+
+    std::map<pid_t, ThreadStats> _threads;
+    std::vector<ThreadStats> _reused;
+    std::vector<pid_t> _tids;
+
+    /* The perf events and their ring buffers, one per CPU */
+    std::vector<int> _fds;
+    std::vector<void*> _buffers;
+
+    /* A record that wraps around the end of a ring buffer */
+    std::vector<uint64_t> _record;
+
+    /* Read the energy of a thread, new threads are added even if that fails */
+    void sample(pid_t tid, bool created=false);
+
+    void scan();
+    void handle(const void *record);
+
+   public:
+    ThreadTracker(pid_t pid);
+    ThreadTracker(const ThreadTracker&) = delete;
+
+    ~ThreadTracker();
+
+    ThreadTracker& operator=(const ThreadTracker&) = delete;
+
+    /* File descriptors that become readable when threads are created or exit */
+    const std::vector<int> &fds() const;
+
+    /* Handle the pending fork and exit notifications */
+    void events();
+
+    void update();
+
+    std::vector<ThreadStats> top(size_t n) const;
+};
+
+#endif /* __THREADS_H__ */
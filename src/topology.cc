@@ -0,0 +1,143 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+
+
+namespace topology {
+
+const std::string sysfs_cpu_root = {"/sys/devices/system/cpu"};
+
+/* Parse the number of a 'cpu<N>' directory entry, -1 for everything else. */
+static int cpu_number(const char *name)
+{
+    if (name[0] != 'c' || name[1] != 'p' || name[2] != 'u' || name[3] == '\0')
+        return -1;
+
+    char *end;
+    long nr = std::strtol(name + 3, &end, 10);
+
+    if (*end != '\0' || nr < 0)
+        return -1;
+
+    return nr;
+}
+
+/* Read a single number from a topology file, -1 on failure. */
+static int read_id(const std::string &path)
+{
+    std::ifstream file{path};
+    int id;
+
+    if (!(file >> id) || id < 0)
+        return -1;
+
+    return id;
+}
+
+/**
+ * Call the function with the CPU, its package and core id for every online
+ * CPU below the root. Returns false if the root could not be read.
+ **/
+template <typename Func>
+static bool for_each_cpu(const std::string &root, Func func)
+{
+    DIR *dir = opendir(root.c_str());
+    if (!dir)
+        return false;
+
+    struct dirent *entry;
+
+    while ((entry = readdir(dir))) {
+        int cpu = cpu_number(entry->d_name);
+        if (cpu < 0)
+            continue;
+
+        /* Offline CPUs have no topology information */
+        std::string topo = root + "/" + entry->d_name + "/topology/";
+        int package = read_id(topo + "physical_package_id");
+
+        if (package < 0)
+            continue;
+
+        func(static_cast<unsigned int>(cpu), static_cast<unsigned int>(package), read_id(topo + "core_id"));
+    }
+
+    closedir(dir);
+    return true;
+}
+
+std::vector<Package> packages(const std::string &root)
+{
+    /* package id -> lowest CPU */
+    std::map<unsigned int, unsigned int> found;
+
+    for_each_cpu(root, [&](unsigned int cpu, unsigned int package, int) {
+        auto it = found.find(package);
+
+        if (it == found.end())
+            found.emplace(package, cpu);
+        else
+            it->second = std::min(it->second, cpu);
+    });
+
+    std::vector<Package> result;
+    for (auto &p : found)
+        result.push_back(Package{p.first, p.second});
+
+    return result;
+}
+
+std::vector<Core> cores(const std::string &root)
+{
+    /* (package id, core id) -> CPUs */
+    std::map<std::pair<unsigned int, unsigned int>, std::vector<unsigned int>> found;
+
+    for_each_cpu(root, [&](unsigned int cpu, unsigned int package, int core) {
+        if (core >= 0)
+            found[{package, core}].push_back(cpu);
+    });
+
+    std::vector<Core> result;
+    for (auto &c : found) {
+        auto cpus = c.second;
+        std::sort(cpus.begin(), cpus.end());
+
+        result.push_back(Core{c.first.first, c.first.second, cpus});
+    }
+
+    return result;
+}
+
+std::vector<int> parse_cpus(const std::string &list)
+{
+    std::vector<int> cpus;
+    const char *pos = list.c_str();
+
+    while (*pos) {
+        char *end;
+        long first = std::strtol(pos, &end, 10), last = first;
+
+        if (end == pos)
+            break;
+
+        if (*end == '-')
+            last = std::strtol(end + 1, &end, 10);
+
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+
+        pos = *end == ',' ? end + 1 : end;
+    }
+
+    return cpus;
+}
+
+} /* namespace topology */
@@ -0,0 +1,55 @@
+#ifndef __TOPOLOGY_H__
+#define __TOPOLOGY_H__
+
+#include <string>
+#include <vector>
+
+
+namespace topology {
+
+/* Default location of the CPU information in sysfs */
+extern const std::string sysfs_cpu_root;
+
+/**
+ * A physical CPU package (socket) together with the CPU that represents it,
+ * i.e. on which its package wide registers are read.
+ **/
+struct Package
+{
+    unsigned int id;
+    unsigned int cpu;
+};
+
+/**
+ * A physical core together with all of its (SMT) CPUs.
+ **/
+struct Core
+{
+    unsigned int package;       /* id of the package */
+    unsigned int id;
+    std::vector<unsigned int> cpus;     /* sorted, the first one represents the core */
+};
+
+/**
+ * Discover all packages from '<root>/cpu<N>/topology/physical_package_id'.
+ * The packages are sorted by their id and represented by their lowest online
+ * CPU. Returns an empty list if the topology could not be read.
+ **/
+std::vector<Package> packages(const std::string &root=sysfs_cpu_root);
+
+/**
+ * Discover all cores from '<root>/cpu<N>/topology/{physical_package_id,core_id}'.
+ * The cores are sorted by package and core id. Returns an empty list if the
+ * topology could not be read.
+ **/
+std::vector<Core> cores(const std::string &root=sysfs_cpu_root);
+
+/**
+ * Parse a cpu list such as '0,24' or '0-3,8' (e.g. a 'cpumask' file of sysfs)
+ * into the listed CPUs.
+ **/
+std::vector<int> parse_cpus(const std::string &list);
+
+} /* namespace topology */
+
+#endif /* __TOPOLOGY_H__ */
@@ -0,0 +1,165 @@
+#include "uring.h"
+
+#include <linux/io_uring.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+int uring_init(struct uring *ring, unsigned entries)
+{
+    struct io_uring_params p;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+
+    ring->fd = io_uring_setup(entries, &p);
+    if (ring->fd < 0)
+        return -1;
+
+    /* IORING_OP_READ is only available since Linux 5.6. Instead of probing
+     * the supported operations, require a feature flag of a kernel that is
+     * new enough. */
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_FAST_POLL)) {
+        close(ring->fd);
+        errno = ENOSYS;
+        return -1;
+    }
+
+    ring->entries = p.sq_entries;
+
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (ring->cq_size > ring->sq_size)
+        ring->sq_size = ring->cq_size;
+    ring->cq_size = ring->sq_size;
+
+    /* With IORING_FEAT_SINGLE_MMAP both rings share the same mapping. */
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED)
+        goto err_close;
+    ring->cq_ptr = ring->sq_ptr;
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+        goto err_unmap;
+
+    ring->sq_head = (unsigned *)((char *)ring->sq_ptr + p.sq_off.head);
+    ring->sq_tail = (unsigned *)((char *)ring->sq_ptr + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)((char *)ring->sq_ptr + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)((char *)ring->sq_ptr + p.sq_off.array);
+
+    ring->cq_head = (unsigned *)((char *)ring->cq_ptr + p.cq_off.head);
+    ring->cq_tail = (unsigned *)((char *)ring->cq_ptr + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)((char *)ring->cq_ptr + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ptr + p.cq_off.cqes);
+
+    return 0;
+
+err_unmap:
+    munmap(ring->sq_ptr, ring->sq_size);
+err_close:
+    close(ring->fd);
+    ring->fd = -1;
+    return -1;
+}
+
+void uring_destroy(struct uring *ring)
+{
+    if (ring->fd < 0)
+        return;
+
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->fd);
+
+    ring->fd = -1;
+}
+
+int uring_read_all(struct uring *ring, const int *fds, char *bufs, size_t buf_size,
+        ssize_t *res, size_t n)
+{
+    size_t idx = 0;
+
+    while (idx < n) {
+        unsigned tail, head, mask, batch, submitted, reaped;
+        int ret;
+
+        /* Fill the submission queue */
+        tail = *ring->sq_tail;
+        mask = *ring->sq_mask;
+
+        for (batch = 0; batch < ring->entries && idx < n; ++idx) {
+            unsigned slot = (tail + batch) & mask;
+            struct io_uring_sqe *sqe = &ring->sqes[slot];
+
+            if (fds[idx] < 0)
+                continue;
+
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fds[idx];
+            sqe->addr = (unsigned long)(bufs + idx * buf_size);
+            sqe->len = (unsigned)buf_size;
+            sqe->off = 0;
+            sqe->user_data = idx;
+
+            ring->sq_array[slot] = slot;
+            batch++;
+        }
+
+        if (batch == 0)
+            break;
+
+        __atomic_store_n(ring->sq_tail, tail + batch, __ATOMIC_RELEASE);
+
+        /* Submit everything and wait until all reads completed. The kernel
+         * does not wait if it could not submit all entries, in which case we
+         * just try again with the remaining ones. */
+        submitted = 0;
+        reaped = 0;
+
+        while (reaped < batch) {
+            do {
+                ret = io_uring_enter(ring->fd, batch - submitted, batch - reaped,
+                        IORING_ENTER_GETEVENTS);
+            } while (ret < 0 && errno == EINTR);
+
+            if (ret < 0)
+                return -1;
+
+            submitted += ret;
+
+            head = *ring->cq_head;
+
+            while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+                struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+
+                res[cqe->user_data] = cqe->res;
+
+                head++;
+                reaped++;
+            }
+
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef __URING_H__
+#define __URING_H__
+
+#include <linux/io_uring.h>
+
+#include <stddef.h>
+#include <unistd.h>
+
+
+/**
+ * Minimal io_uring instance which is used by libeteam to read many procfs
+ * files with a single system call.
+ **/
+struct uring {
+    int fd;
+    unsigned entries;
+
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+/**
+ * Set up a new io_uring instance.
+ *
+ * @param[out] ring:    The ring that should be initialized.
+ * @param[in] entries:  The number of submission queue entries.
+ *
+ * @returns:            0 on success, -1 if io_uring is not available (setting
+ *                      errno accordingly)
+ **/
+int uring_init(struct uring *ring, unsigned entries);
+
+/**
+ * Release all resources of an io_uring instance.
+ **/
+void uring_destroy(struct uring *ring);
+
+/**
+ * Read the beginning of all the given files in one batch.
+ *
+ * @param[in] ring:     The ring that should be used.
+ * @param[in] fds:      The n files that should be read. Negative entries are
+ *                      skipped and their result is left untouched.
+ * @param[out] bufs:    Buffer with n * buf_size bytes, the i-th file is read
+ *                      into the i-th chunk of it.
+ * @param[in] buf_size: The size of a single chunk.
+ * @param[out] res:     The number of bytes read for every file, or the
+ *                      negative errno value if reading the file failed.
+ * @param[in] n:        The number of files.
+ *
+ * @returns:            0 on success, -1 if the ring itself failed (setting
+ *                      errno accordingly)
+ **/
+int uring_read_all(struct uring *ring, const int *fds, char *bufs, size_t buf_size,
+        ssize_t *res, size_t n);
+
+#endif /* __URING_H__ */
@@ -0,0 +1,81 @@
+/**
+ * Checks the ratio estimator of the sampling windows (estimate()) against
+ * values computed by hand: exact ratios, a single window, windows without CPU
+ * time, the finite population correction and the confidence interval of two
+ * windows.
+ **/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "../src/estimate.h"
+
+
+static int failures = 0;
+
+static Window window(unsigned long long package, unsigned long long core, double time)
+{
+    Window w{};
+    w.energy.package = package;
+    w.energy.core = core;
+    w.time = time;
+
+    return w;
+}
+
+static bool close_to(double value, double expected)
+{
+    if (std::isnan(expected))
+        return std::isnan(value);
+
+    return std::fabs(value - expected) <= 1e-6 * std::max(1.0, std::fabs(expected));
+}
+
+static void check(const char *name, const Interval &i, double value, double error)
+{
+    if (!close_to(i.value, value) || !close_to(i.error, error)) {
+        std::printf("FAIL: %s: %g +- %g instead of %g +- %g\n", name, i.value, i.error, value, error);
+        failures++;
+    }
+}
+
+int main()
+{
+    const double nan = std::nan("");
+
+    /* 10 J per CPU second in every window, extrapolated to 12 s without error */
+    auto e = estimate({window(10, 1, 1), window(20, 4, 2), window(30, 9, 3)}, 12);
+    check("exact ratio", e.package, 120, 0);
+
+    /* The core domain is estimated on its own: ratio 14 / 6, residuals -4/3,
+     * -2/3 and 2, half of the time measured and a mean time of 2 s */
+    double variance = (16.0 / 9 + 4.0 / 9 + 4) / 2;
+    check("core", e.core, 14.0 / 6 * 12, 4.303 * std::sqrt(0.5 * variance / 3) / 2 * 12);
+
+    if (e.windows != 3) {
+        std::printf("FAIL: %zu windows instead of 3\n", e.windows);
+        failures++;
+    }
+
+    /* A single window has no variance */
+    check("single window", estimate({window(50, 0, 2)}, 10).package, 250, nan);
+
+    /* Without CPU time there is nothing to extrapolate from */
+    check("no time", estimate({window(7, 0, 0), window(3, 0, 0)}, 10).package, 10, nan);
+
+    /* Everything was measured, hence there is no sampling error */
+    check("all measured", estimate({window(10, 0, 1), window(30, 0, 1)}, 2).package, 40, 0);
+    check("more than all", estimate({window(10, 0, 1), window(30, 0, 1)}, 1.5).package, 30, 0);
+
+    /* Ratio 20, residuals -10 and 10, variance 200, half of the time measured:
+     * 12.706 * sqrt(0.5 * 200 / 2) / 1 * 4 */
+    check("two windows", estimate({window(10, 0, 1), window(30, 0, 1)}, 4).package,
+            80, 12.706 * std::sqrt(50.0) * 4);
+
+    if (failures == 0)
+        std::printf("All estimates are correct\n");
+
+    return failures > 0;
+}
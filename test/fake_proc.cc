@@ -0,0 +1,115 @@
+#include "fake_proc.h"
+
+#include <cerrno>
+#include <cstdarg>
+#include <map>
+#include <string>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+namespace fake_proc {
+
+struct File
+{
+    int fd;             /* memory file with the content, -1 if removed */
+    unsigned opens;
+};
+
+static std::map<std::string, File> files;
+
+void set(const std::string &path, const std::string &content)
+{
+    File &file = files.emplace(path, File{-1, 0}).first->second;
+
+    /* A removed file comes back as a new one, old files stay empty */
+    if (file.fd < 0)
+        file.fd = memfd_create("fake_proc", MFD_CLOEXEC);
+
+    ftruncate(file.fd, 0);
+    pwrite(file.fd, content.data(), content.size(), 0);
+}
+
+void remove(const std::string &path)
+{
+    auto it = files.find(path);
+
+    if (it == files.end() || it->second.fd < 0)
+        return;
+
+    ftruncate(it->second.fd, 0);
+    close(it->second.fd);
+    it->second.fd = -1;
+}
+
+unsigned opens(const std::string &path)
+{
+    auto it = files.find(path);
+
+    return it == files.end() ? 0 : it->second.opens;
+}
+
+std::string energystat(unsigned long long package)
+{
+    /* package dram core gpu */
+    return std::to_string(package) + " 0 0 0\n";
+}
+
+std::string stat(pid_t tid, unsigned long long start)
+{
+    std::string line = std::to_string(tid) + " (fake) S";
+
+    /* Fields 4 to 21, the start time is field 22 */
+    for (int i = 4; i < 22; ++i)
+        line += " 0";
+
+    return line + " " + std::to_string(start) + " 0 0\n";
+}
+
+std::string process_energystat(pid_t pid)
+{
+    return "/proc/" + std::to_string(pid) + "/energystat";
+}
+
+std::string task_energystat(pid_t pid, pid_t tid)
+{
+    return "/proc/" + std::to_string(pid) + "/task/" + std::to_string(tid) + "/energystat";
+}
+
+} /* namespace fake_proc */
+
+
+extern "C" int open(const char *path, int flags, ...)
+{
+    using open_func = int (*)(const char *, int, ...);
+    static open_func real_open = reinterpret_cast<open_func>(dlsym(RTLD_NEXT, "open"));
+
+    mode_t mode = 0;
+
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+
+    auto it = fake_proc::files.find(path);
+    if (it == fake_proc::files.end())
+        return real_open(path, flags, mode);
+
+    if (it->second.fd < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    it->second.opens++;
+
+    /* A new open file description, so that read() does not share the offset */
+    std::string fd_path = "/proc/self/fd/" + std::to_string(it->second.fd);
+
+    return real_open(fd_path.c_str(), flags, mode);
+}
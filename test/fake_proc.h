@@ -0,0 +1,39 @@
+#ifndef __FAKE_PROC_H__
+#define __FAKE_PROC_H__
+
+#include <string>
+
+#include <unistd.h>
+
+/**
+ * Fake files below /proc for the tests of libeteam, which need E-Team's
+ * energystat files (and a few others) without the kernel. The test program
+ * defines open(), which libeteam binds to when it is linked statically: the
+ * faked paths are served from memory files, all others are opened as usual.
+ **/
+namespace fake_proc {
+
+/* Serve the path with the given content, an already faked file is updated in
+ * place (i.e. open files see the new content, like with procfs). */
+void set(const std::string &path, const std::string &content);
+
+/* The path vanishes: open files read nothing anymore, new opens fail with
+ * ENOENT until the path is set again. */
+void remove(const std::string &path);
+
+/* Number of times the path was opened */
+unsigned opens(const std::string &path);
+
+/* The content of an energystat file with the given package energy (in uJ) */
+std::string energystat(unsigned long long package);
+
+/* The content of a stat file of the task with the given start time */
+std::string stat(pid_t tid, unsigned long long start);
+
+/* Paths of the energystat file of a process and of one of its threads */
+std::string process_energystat(pid_t pid);
+std::string task_energystat(pid_t pid, pid_t tid);
+
+} /* namespace fake_proc */
+
+#endif /* __FAKE_PROC_H__ */
@@ -0,0 +1,131 @@
+/**
+ * Checks the cache of open energystat files behind consumed_energy_many()
+ * with faked files: cached files are read again without opening them, a file
+ * that reads nothing (the process exited) is replaced by a fresh one, unused
+ * files expire after PID_CACHE_MAX_AGE queries and large batches (read with
+ * io_uring if available) return the value of every pid.
+ **/
+
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <eteam.h>
+
+#include "fake_proc.h"
+
+
+static int failures = 0;
+
+/* Fake pids, far beyond pid_max */
+static const pid_t first_pid = 10000000;
+
+static void check(const char *name, bool ok)
+{
+    if (!ok) {
+        std::printf("FAIL: %s\n", name);
+        failures++;
+    }
+}
+
+/* Query the given pids in one batch and compare the result with the expected
+ * package energies (0 for an expected error). */
+static void check_query(const char *name, const std::vector<pid_t> &pids,
+        const std::vector<unsigned long long> &expected, int expected_error=ENOENT)
+{
+    std::vector<struct energy> energies(pids.size());
+    std::vector<int> errors(pids.size());
+    int failed = 0;
+
+    int ret = consumed_energy_many(pids.data(), pids.size(), energies.data(), errors.data());
+
+    for (size_t i = 0; i < pids.size(); ++i) {
+        bool ok = expected[i] == 0 ? errors[i] == expected_error :
+            errors[i] == 0 && energies[i].package == expected[i];
+
+        if (!ok) {
+            std::printf("FAIL: %s: pid %d read %llu (error %d) instead of %llu\n", name, pids[i],
+                    energies[i].package, errors[i], expected[i]);
+            failures++;
+        }
+
+        failed += expected[i] == 0;
+    }
+
+    if (ret != failed) {
+        std::printf("FAIL: %s: %d pids failed instead of %d\n", name, ret, failed);
+        failures++;
+    }
+}
+
+int main()
+{
+    pid_t a = first_pid, b = first_pid + 1, unknown = first_pid + 2;
+    auto path_a = fake_proc::process_energystat(a);
+    auto path_b = fake_proc::process_energystat(b);
+
+    fake_proc::set(path_a, fake_proc::energystat(10));
+    fake_proc::set(path_b, fake_proc::energystat(20));
+
+    /* The files are opened once ... */
+    check_query("first query", {a, b, unknown}, {10, 20, 0});
+    check("file opened", fake_proc::opens(path_a) == 1 && fake_proc::opens(path_b) == 1);
+
+    /* ... and read again afterwards */
+    fake_proc::set(path_a, fake_proc::energystat(11));
+    check_query("cached query", {a, b}, {11, 20});
+    check("file cached", fake_proc::opens(path_a) == 1 && fake_proc::opens(path_b) == 1);
+
+    /* The process exited, the cached file is replaced by a fresh one */
+    fake_proc::remove(path_a);
+    check_query("exited", {a, b}, {0, 20});
+    check("exited not cached", fake_proc::opens(path_a) == 1);
+
+    /* ... and its pid is reused by another process */
+    fake_proc::set(path_a, fake_proc::energystat(5));
+    check_query("pid reused", {a, b}, {5, 20});
+    check("reused file opened", fake_proc::opens(path_a) == 2);
+
+    /* An unused file stays cached for PID_CACHE_MAX_AGE (8) queries ... */
+    for (int i = 0; i < 8; ++i)
+        check_query("other pid", {b}, {20});
+
+    check_query("not expired", {a}, {5});
+    check("file not expired", fake_proc::opens(path_a) == 2);
+
+    /* ... and is closed after that */
+    for (int i = 0; i < 9; ++i)
+        check_query("other pid", {b}, {20});
+
+    check_query("expired", {a}, {5});
+    check("expired file opened", fake_proc::opens(path_a) == 3);
+
+    /* Large batches are read with io_uring if it is available */
+    std::vector<pid_t> pids;
+    std::vector<unsigned long long> expected;
+
+    for (pid_t pid = first_pid + 100; pid < first_pid + 300; ++pid) {
+        fake_proc::set(fake_proc::process_energystat(pid), fake_proc::energystat(pid));
+        pids.push_back(pid);
+        expected.push_back(pid);
+    }
+
+    check_query("batch", pids, expected);
+
+    for (auto &e : expected)
+        e++;
+    for (auto pid : pids)
+        fake_proc::set(fake_proc::process_energystat(pid), fake_proc::energystat(pid + 1));
+
+    check_query("cached batch", pids, expected);
+    check("batch cached", fake_proc::opens(fake_proc::process_energystat(pids.back())) == 1);
+
+    /* Invalid pids fail on their own */
+    check_query("invalid pid", {b, -1}, {20, 0}, EINVAL);
+
+    if (failures == 0)
+        std::printf("The pid cache works\n");
+
+    return failures > 0;
+}
@@ -0,0 +1,82 @@
+/**
+ * Checks detail::rapl::to_microjoules() against an exact 128 bit reference for the
+ * energy status units (ESU) found on real CPUs, for ESU=0 and for the largest
+ * tick counts whose energy still fits into 64 bits.
+ **/
+
+#include <cstdio>
+#include <limits>
+
+#include "../src/measure.h"
+
+
+static int failures = 0;
+
+/* ticks * 10^6 / 2^esu, rounded to the nearest uJ */
+static unsigned long long reference(unsigned long long ticks, unsigned int esu)
+{
+    unsigned __int128 uj = static_cast<unsigned __int128>(ticks) * 1000000U;
+
+    return static_cast<unsigned long long>((uj + (static_cast<unsigned __int128>(1) << esu >> 1)) >> esu);
+}
+
+static void check(unsigned long long ticks, unsigned int esu, unsigned long long expected)
+{
+    auto uj = detail::rapl::to_microjoules(ticks, esu);
+
+    if (uj != expected) {
+        std::printf("FAIL: %llu ticks with ESU %u: %llu uJ instead of %llu uJ\n", ticks, esu, uj, expected);
+        failures++;
+    }
+}
+
+/* The largest number of ticks whose energy in uJ fits into 64 bits */
+static unsigned long long max_ticks(unsigned int esu)
+{
+    unsigned __int128 max = (static_cast<unsigned __int128>(std::numeric_limits<unsigned long long>::max())
+            << esu) / 1000000U;
+
+    if (max > std::numeric_limits<unsigned long long>::max())
+        return std::numeric_limits<unsigned long long>::max();
+
+    return static_cast<unsigned long long>(max);
+}
+
+int main()
+{
+    /* Known values: Intel client and server parts (ESU 14, 61.035 uJ), the
+     * fixed DRAM unit of server parts (ESU 16, 15.3 uJ) and AMD Zen (ESU 16) */
+    check(1, 14, 61);
+    check(3, 14, 183);
+    check(16384, 14, 1000000);
+    check(1, 16, 15);
+    check(2, 16, 31);
+    check(65536, 16, 1000000);
+
+    /* Truncating the unit to 61 uJ lost 0.06% (61000000000 uJ) */
+    check(1000000000ULL, 14, 61035156250ULL);
+
+    /* One tick is one J */
+    check(0, 0, 0);
+    check(1, 0, 1000000);
+    check(max_ticks(0), 0, reference(max_ticks(0), 0));
+
+    /* The whole range of the unit, with the largest values of the 32-bit
+     * registers and of the accumulated ticks */
+    for (unsigned int esu = 0; esu < 32; ++esu) {
+        unsigned long long values[] = {
+            0, 1, 2, (1ULL << esu) - 1, 1ULL << esu, (1ULL << esu) + 1, 123456789,
+            0xffffffffULL, 0x100000000ULL, max_ticks(esu) - 1, max_ticks(esu)
+        };
+
+        for (auto ticks : values) {
+            if (ticks <= max_ticks(esu))
+                check(ticks, esu, reference(ticks, esu));
+        }
+    }
+
+    if (failures == 0)
+        std::printf("All conversions are exact\n");
+
+    return failures > 0;
+}
@@ -0,0 +1,215 @@
+/**
+ * Checks consumed_energy_shm() against a segment published by the test itself:
+ * the errors without a publisher, without a sample and with a stale one, that
+ * readers never see a half written slot while it is updated concurrently and
+ * that readers attach to the new segment of a restarted publisher.
+ **/
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+
+#include <eteam.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../src/shm.h"
+
+
+static int failures = 0;
+
+static const pid_t pid = 4242;
+
+static void check_read(const char *name, unsigned long long expected, int expected_error=0)
+{
+    struct energy energy;
+
+    int ret = consumed_energy_shm(pid, &energy, nullptr);
+    int error = ret < 0 ? errno : 0;
+
+    if (error != expected_error || (ret == 0 && energy.package != expected)) {
+        std::printf("FAIL: %s: read %llu (error %d) instead of %llu (error %d)\n", name,
+                ret == 0 ? energy.package : 0, error, expected, expected_error);
+        failures++;
+    }
+}
+
+static unsigned long long now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Create a new segment like 'energy --publish' does */
+static eteam_shm *publish(unsigned long long interval)
+{
+    shm_unlink(ETEAM_SHM_NAME);
+
+    int fd = shm_open(ETEAM_SHM_NAME, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0 || ftruncate(fd, sizeof(eteam_shm)) < 0)
+        return nullptr;
+
+    void *mem = mmap(nullptr, sizeof(eteam_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mem == MAP_FAILED)
+        return nullptr;
+
+    auto shm = static_cast<eteam_shm *>(mem);
+
+    shm->version = ETEAM_SHM_VERSION;
+    shm->interval = interval;
+    __atomic_store_n(&shm->magic, ETEAM_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return shm;
+}
+
+/* The publisher leaves */
+static void unpublish(eteam_shm *shm)
+{
+    __atomic_store_n(&shm->magic, 0, __ATOMIC_RELEASE);
+    munmap(shm, sizeof(*shm));
+    shm_unlink(ETEAM_SHM_NAME);
+}
+
+static eteam_shm_slot *find_slot(eteam_shm *shm)
+{
+    for (unsigned i = eteam_shm_hash(pid), n = 0; n < ETEAM_SHM_SLOTS; i = (i + 1) & (ETEAM_SHM_SLOTS - 1), ++n) {
+        if (__atomic_load_n(&shm->slots[i].pid, __ATOMIC_ACQUIRE) == pid)
+            return &shm->slots[i];
+    }
+
+    return nullptr;
+}
+
+/* Write a sample with all domains set to value under the sequence lock */
+static void write_slot(eteam_shm_slot *slot, unsigned long long value, unsigned long long timestamp,
+        int error=0)
+{
+    unsigned seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    __atomic_store_n(&slot->energy.package, value, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->energy.core, value, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->energy.dram, value, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->energy.gpu, value, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->timestamp, timestamp, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->error, error, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* Read while another thread keeps updating the slot */
+static void check_concurrent(eteam_shm_slot *slot)
+{
+    std::atomic<bool> done{false};
+
+    std::thread writer([&]() {
+        for (unsigned long long value = 1; !done.load(std::memory_order_relaxed); ++value)
+            write_slot(slot, value, now());
+    });
+
+    for (int i = 0; i < 100000; ++i) {
+        struct energy energy;
+
+        if (consumed_energy_shm(pid, &energy, nullptr) < 0) {
+            /* The writer may keep the slot busy for all retries */
+            if (errno == EAGAIN)
+                continue;
+
+            std::printf("FAIL: concurrent read failed (%d)\n", errno);
+            failures++;
+            break;
+        }
+
+        if (energy.core != energy.package || energy.dram != energy.package ||
+                energy.gpu != energy.package) {
+            std::printf("FAIL: torn read %llu %llu %llu %llu\n", energy.package, energy.core,
+                    energy.dram, energy.gpu);
+            failures++;
+            break;
+        }
+    }
+
+    done = true;
+    writer.join();
+}
+
+int main()
+{
+    const unsigned long long interval = 1000000000ULL;
+    struct energy energy;
+
+    shm_unlink(ETEAM_SHM_NAME);
+    check_read("no publisher", 0, ENOENT);
+
+    eteam_shm *shm = publish(interval);
+    if (!shm) {
+        std::perror("publish");
+        return 1;
+    }
+
+    /* The first read registers the pid for the publisher */
+    check_read("not sampled yet", 0, EAGAIN);
+
+    eteam_shm_slot *slot = find_slot(shm);
+    if (!slot) {
+        std::printf("FAIL: the pid was not registered\n");
+        unpublish(shm);
+        return 1;
+    }
+
+    write_slot(slot, 10, now());
+    check_read("sampled", 10);
+
+    write_slot(slot, 11, now(), ESRCH);
+    check_read("sample failed", 0, ESRCH);
+
+    /* The publisher is busy with the slot */
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+    check_read("slot busy", 0, EAGAIN);
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+
+    /* The value is returned anyway if the publisher fell behind */
+    write_slot(slot, 12, now() - 3 * interval);
+    if (consumed_energy_shm(pid, &energy, nullptr) == 0 || errno != ESTALE || energy.package != 12) {
+        std::printf("FAIL: stale sample not reported\n");
+        failures++;
+    }
+
+    check_concurrent(slot);
+
+    /* The publisher is restarted with a new segment */
+    unpublish(shm);
+    check_read("publisher gone", 0, ESTALE);
+
+    shm = publish(interval);
+    if (!shm) {
+        std::perror("publish");
+        return 1;
+    }
+
+    check_read("new segment", 0, EAGAIN);
+
+    slot = find_slot(shm);
+    if (slot)
+        write_slot(slot, 20, now());
+
+    check_read("new publisher", 20);
+
+    unpublish(shm);
+
+    if (failures == 0)
+        std::printf("The shared memory is read consistently\n");
+
+    return failures > 0;
+}
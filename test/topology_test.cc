@@ -0,0 +1,107 @@
+/**
+ * Checks the topology discovery against a synthetic sysfs tree: two packages
+ * with two SMT cores each, numbered like on real servers (the siblings of a
+ * core are not adjacent), an offline CPU without topology information and
+ * unrelated entries. Also checks parse_cpus() with the formats of sysfs.
+ **/
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../src/topology.h"
+
+
+static int failures = 0;
+
+static void check(const char *name, bool ok)
+{
+    if (!ok) {
+        std::printf("FAIL: %s\n", name);
+        failures++;
+    }
+}
+
+static void write_file(const std::string &path, const std::string &content)
+{
+    std::ofstream{path} << content << "\n";
+}
+
+/* Add a CPU to the tree, without topology if the package is negative */
+static void add_cpu(const std::string &root, unsigned int cpu, int package, int core)
+{
+    std::string dir = root + "/cpu" + std::to_string(cpu);
+
+    mkdir(dir.c_str(), 0755);
+    if (package < 0)
+        return;
+
+    mkdir((dir + "/topology").c_str(), 0755);
+    write_file(dir + "/topology/physical_package_id", std::to_string(package));
+    write_file(dir + "/topology/core_id", std::to_string(core));
+}
+
+int main()
+{
+    char root_template[] = "/tmp/topology_test.XXXXXX";
+    char *root_dir = mkdtemp(root_template);
+
+    if (!root_dir) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+
+    std::string root{root_dir};
+
+    /* CPU n and n + 4 are siblings, CPU 8 is offline */
+    add_cpu(root, 0, 0, 0);
+    add_cpu(root, 1, 0, 1);
+    add_cpu(root, 2, 1, 0);
+    add_cpu(root, 3, 1, 1);
+    add_cpu(root, 4, 0, 0);
+    add_cpu(root, 5, 0, 1);
+    add_cpu(root, 6, 1, 0);
+    add_cpu(root, 7, 1, 1);
+    add_cpu(root, 8, -1, -1);
+    mkdir((root + "/cpufreq").c_str(), 0755);
+    write_file(root + "/online", "0-7");
+
+    auto packages = topology::packages(root);
+
+    check("two packages", packages.size() == 2);
+    check("package 0 on CPU 0", packages.size() > 0 && packages[0].id == 0 && packages[0].cpu == 0);
+    check("package 1 on CPU 2", packages.size() > 1 && packages[1].id == 1 && packages[1].cpu == 2);
+
+    auto cores = topology::cores(root);
+    std::vector<std::vector<unsigned int>> expected = {{0, 4}, {1, 5}, {2, 6}, {3, 7}};
+
+    check("four cores", cores.size() == expected.size());
+
+    for (size_t i = 0; i < cores.size() && i < expected.size(); ++i) {
+        if (cores[i].package != i / 2 || cores[i].id != i % 2 || cores[i].cpus != expected[i]) {
+            std::printf("FAIL: core %zu is %u/%u\n", i, cores[i].package, cores[i].id);
+            failures++;
+        }
+    }
+
+    check("missing root", topology::packages(root + "/missing").empty() &&
+            topology::cores(root + "/missing").empty());
+
+    check("single cpu", topology::parse_cpus("0\n") == std::vector<int>{0});
+    check("cpu list", topology::parse_cpus("0,24") == std::vector<int>{0, 24});
+    check("cpu ranges", topology::parse_cpus("0-2,8,10-11") == std::vector<int>{0, 1, 2, 8, 10, 11});
+    check("empty list", topology::parse_cpus("").empty());
+
+    std::string cleanup = "rm -rf '" + root + "'";
+    std::system(cleanup.c_str());
+
+    if (failures == 0)
+        std::printf("The topology is discovered correctly\n");
+
+    return failures > 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * Checks eteam_tree_read() on a real process tree with faked energystat files:
+ * a process A with a child B. The energy of tasks that exited is kept, a tid
+ * that was reused (another start time) counts as a new task and B is still
+ * followed after A exited and B was reparented.
+ **/
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <string>
+
+#include <eteam.h>
+
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "fake_proc.h"
+
+
+static int failures = 0;
+
+static void check_read(const char *name, struct eteam_tree *tree, unsigned long long expected,
+        int expected_pids)
+{
+    struct energy energy;
+
+    if (eteam_tree_read(tree, &energy) < 0) {
+        std::printf("FAIL: %s: read failed (%d)\n", name, errno);
+        failures++;
+        return;
+    }
+
+    if (energy.package != expected) {
+        std::printf("FAIL: %s: %llu instead of %llu\n", name, energy.package, expected);
+        failures++;
+    }
+
+    int pids = eteam_tree_pids(tree, nullptr, 0);
+    if (pids != expected_pids) {
+        std::printf("FAIL: %s: %d processes instead of %d\n", name, pids, expected_pids);
+        failures++;
+    }
+}
+
+/* Process A: start B, report its pid and exit when told so */
+static void run_a(int report, int exit)
+{
+    pid_t b = fork();
+    if (b == 0) {
+        for (;;)
+            pause();
+    }
+
+    char c;
+
+    write(report, &b, sizeof(b));
+    read(exit, &c, 1);
+    _exit(0);
+}
+
+int main()
+{
+    int report[2], exit[2];
+
+    /* B is reparented to us once A exited */
+    if (pipe(report) < 0 || pipe(exit) < 0 || prctl(PR_SET_CHILD_SUBREAPER, 1) < 0) {
+        std::perror("setup");
+        return 1;
+    }
+
+    pid_t a = fork();
+    if (a == 0)
+        run_a(report[1], exit[0]);
+
+    pid_t b;
+    if (a < 0 || read(report[0], &b, sizeof(b)) != sizeof(b)) {
+        std::perror("fork");
+        return 1;
+    }
+
+    fake_proc::set(fake_proc::task_energystat(a, a), fake_proc::energystat(10));
+    fake_proc::set(fake_proc::task_energystat(b, b), fake_proc::energystat(100));
+
+    struct eteam_tree *tree = eteam_tree_open(a);
+    if (!tree) {
+        std::perror("eteam_tree_open");
+        return 1;
+    }
+
+    check_read("tree", tree, 110, 2);
+
+    fake_proc::set(fake_proc::task_energystat(a, a), fake_proc::energystat(20));
+    check_read("update", tree, 120, 2);
+
+    /* Another task with the tid of B (i.e. another start time): the 100 of
+     * the old one are kept */
+    std::string stat_b = "/proc/" + std::to_string(b) + "/task/" + std::to_string(b) + "/stat";
+
+    fake_proc::set(stat_b, fake_proc::stat(b, 1));
+    fake_proc::set(fake_proc::task_energystat(b, b), fake_proc::energystat(5));
+    check_read("reused tid", tree, 125, 2);
+
+    /* A exits, B is not reachable from the root anymore but still followed */
+    write(exit[1], "x", 1);
+    waitpid(a, nullptr, 0);
+
+    fake_proc::set(fake_proc::task_energystat(b, b), fake_proc::energystat(50));
+    check_read("orphan", tree, 170, 1);
+
+    /* B exits as well, its last value is kept */
+    kill(b, SIGKILL);
+    waitpid(b, nullptr, 0);
+    fake_proc::remove(stat_b);
+
+    check_read("all exited", tree, 170, 0);
+
+    eteam_tree_close(tree);
+
+    if (failures == 0)
+        std::printf("The process tree is followed\n");
+
+    return failures > 0;
+}